@@ -0,0 +1,654 @@
+#ifndef AISDI_MAPS_BTREEMAP_H
+#define AISDI_MAPS_BTREEMAP_H
+
+#include <cstddef>
+#include <initializer_list>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace aisdi
+{
+
+///B+ drzewo: wartości tylko w liściach połączonych w listę, węzły wewnętrzne trzymają same klucze
+template <typename KeyType, typename ValueType>
+class BTreeMap
+{
+public:
+  using key_type = KeyType;
+  using mapped_type = ValueType;
+  using value_type = std::pair<const key_type, mapped_type>;
+  using size_type = std::size_t;
+  using reference = value_type&;
+  using const_reference = const value_type&;
+
+  class ConstIterator;
+  class Iterator;
+  using iterator = Iterator;
+  using const_iterator = ConstIterator;
+
+  static constexpr size_type node_bytes = 512; ///docelowy rozmiar węzła - kilka linii cache
+
+protected:
+  static constexpr size_type leaf_slots = node_bytes / sizeof(value_type) > 4 ? node_bytes / sizeof(value_type) : 4;
+  static constexpr size_type inner_slots = node_bytes / (sizeof(key_type) + sizeof(void*)) > 4
+                                           ? node_bytes / (sizeof(key_type) + sizeof(void*)) : 4;
+  static constexpr size_type min_leaf = leaf_slots / 2;
+  static constexpr size_type min_inner = inner_slots / 2;
+
+  struct Inner;
+
+  struct Node
+  {
+    Inner *parent;
+    size_type count;
+    bool leaf;
+    explicit Node(bool leaf) : parent(nullptr), count(0), leaf(leaf) {}
+  };
+
+  struct Leaf : Node
+  {
+    Leaf *prev, *next;
+    typename std::aligned_storage<sizeof(value_type), alignof(value_type)>::type storage[leaf_slots];
+    Leaf() : Node(true), prev(nullptr), next(nullptr) {}
+    ~Leaf() { for(size_type i = 0; i < this->count; ++i) slot(i)->~value_type(); }
+    value_type* slot(size_type i) { return reinterpret_cast<value_type*>(&storage[i]); }
+    const value_type* slot(size_type i) const { return reinterpret_cast<const value_type*>(&storage[i]); }
+  };
+
+  struct Inner : Node ///count to liczba kluczy, dzieci jest o jedno więcej
+  {
+    typename std::aligned_storage<sizeof(key_type), alignof(key_type)>::type storage[inner_slots];
+    Node *children[inner_slots + 1];
+    Inner() : Node(false) {}
+    ~Inner() { for(size_type i = 0; i < this->count; ++i) key(i)->~key_type(); }
+    key_type* key(size_type i) { return reinterpret_cast<key_type*>(&storage[i]); }
+    const key_type* key(size_type i) const { return reinterpret_cast<const key_type*>(&storage[i]); }
+  };
+
+  Node* root;
+  Leaf* head;
+  Leaf* tail;
+  size_type size;
+
+  ///metody pomocnicze
+
+  void destroy(Node* node)
+  {
+    if(node->leaf) {
+      delete static_cast<Leaf*>(node);
+      return;
+    }
+    Inner* inner = static_cast<Inner*>(node);
+    for(size_type i = 0; i <= inner->count; ++i)
+      destroy(inner->children[i]);
+    delete inner;
+  }
+
+  void erase()
+  {
+    if(root != nullptr) destroy(root);
+    root = nullptr;
+    head = tail = nullptr;
+    size = 0;
+  }
+
+  static size_type lowerBound(const Leaf* leaf, const key_type& key) ///pierwszy slot >= key
+  {
+    size_type lo = 0, hi = leaf->count;
+    while(lo < hi) {
+      size_type mid = (lo + hi) / 2;
+      if(leaf->slot(mid)->first < key)  lo = mid + 1;
+      else  hi = mid;
+    }
+    return lo;
+  }
+
+  static size_type upperBound(const Inner* inner, const key_type& key) ///pierwszy klucz > key
+  {
+    size_type lo = 0, hi = inner->count;
+    while(lo < hi) {
+      size_type mid = (lo + hi) / 2;
+      if(key < *inner->key(mid))  hi = mid;
+      else  lo = mid + 1;
+    }
+    return lo;
+  }
+
+  static size_type childIndex(const Inner* parent, const Node* child)
+  {
+    size_type i = 0;
+    while(parent->children[i] != child) ++i;
+    return i;
+  }
+
+  Leaf* findLeaf(const key_type& key) const
+  {
+    Node* node = root;
+    while(!node->leaf) {
+      const Inner* inner = static_cast<const Inner*>(node);
+      node = inner->children[upperBound(inner, key)];
+    }
+    return static_cast<Leaf*>(node);
+  }
+
+  std::pair<Leaf*, size_type> getNode(const key_type& key) const
+  {
+    if(root == nullptr) return std::make_pair(nullptr, 0);
+    Leaf* leaf = findLeaf(key);
+    size_type pos = lowerBound(leaf, key);
+    if(pos < leaf->count && !(key < leaf->slot(pos)->first)) return std::make_pair(leaf, pos);
+    return std::make_pair(nullptr, 0);
+  }
+
+  static void moveSlot(Leaf* from, size_type i, Leaf* to, size_type j)
+  {
+    new (to->slot(j)) value_type(std::move(*from->slot(i)));
+    from->slot(i)->~value_type();
+  }
+
+  static void moveKey(Inner* from, size_type i, Inner* to, size_type j)
+  {
+    new (to->key(j)) key_type(std::move(*from->key(i)));
+    from->key(i)->~key_type();
+  }
+
+  void insertIntoParent(Node* left, const key_type& key, Node* right) ///po podziale węzła
+  {
+    Inner* parent = left->parent;
+    if(parent == nullptr) {
+      parent = new Inner;
+      new (parent->key(0)) key_type(key);
+      parent->children[0] = left;
+      parent->children[1] = right;
+      parent->count = 1;
+      left->parent = right->parent = parent;
+      root = parent;
+      return;
+    }
+
+    size_type i = childIndex(parent, left);
+    if(parent->count == inner_slots) {
+      Inner* sibling = new Inner;
+      size_type mid = parent->count / 2; ///klucz mid wędruje piętro wyżej
+      for(size_type j = mid + 1; j < parent->count; ++j)
+        moveKey(parent, j, sibling, j - mid - 1);
+      for(size_type j = mid + 1; j <= parent->count; ++j) {
+        sibling->children[j - mid - 1] = parent->children[j];
+        parent->children[j]->parent = sibling;
+      }
+      sibling->count = parent->count - mid - 1;
+      key_type up(std::move(*parent->key(mid)));
+      parent->key(mid)->~key_type();
+      parent->count = mid;
+      insertIntoParent(parent, up, sibling);
+      if(i > mid) {
+        parent = sibling;
+        i -= mid + 1;
+      }
+    }
+
+    for(size_type j = parent->count; j > i; --j)
+      moveKey(parent, j - 1, parent, j);
+    for(size_type j = parent->count + 1; j > i + 1; --j)
+      parent->children[j] = parent->children[j - 1];
+    new (parent->key(i)) key_type(key);
+    parent->children[i + 1] = right;
+    right->parent = parent;
+    ++parent->count;
+  }
+
+  Leaf* splitLeaf(Leaf* leaf)
+  {
+    Leaf* right = new Leaf;
+    size_type half = leaf->count / 2;
+    for(size_type j = half; j < leaf->count; ++j)
+      moveSlot(leaf, j, right, j - half);
+    right->count = leaf->count - half;
+    leaf->count = half;
+
+    right->next = leaf->next;
+    if(right->next != nullptr) right->next->prev = right;
+    else  tail = right;
+    right->prev = leaf;
+    leaf->next = right;
+
+    insertIntoParent(leaf, right->slot(0)->first, right);
+    return right;
+  }
+
+  std::pair<Leaf*, size_type> insert(const key_type& key) ///zwraca pozycję klucza, dodaje go jeśli go nie było
+  {
+    if(root == nullptr) {
+      Leaf* leaf = new Leaf;
+      root = head = tail = leaf;
+    }
+    Leaf* leaf = findLeaf(key);
+    size_type pos = lowerBound(leaf, key);
+    if(pos < leaf->count && !(key < leaf->slot(pos)->first)) return std::make_pair(leaf, pos);
+
+    if(leaf->count == leaf_slots) {
+      Leaf* right = splitLeaf(leaf);
+      if(pos > leaf->count) {
+        pos -= leaf->count;
+        leaf = right;
+      }
+    }
+    for(size_type j = leaf->count; j > pos; --j)
+      moveSlot(leaf, j - 1, leaf, j);
+    new (leaf->slot(pos)) value_type(key, mapped_type());
+    ++leaf->count;
+    ++size;
+    return std::make_pair(leaf, pos);
+  }
+
+  void removeFromInner(Inner* inner, size_type k) ///usuwa klucz k i dziecko k + 1
+  {
+    inner->key(k)->~key_type();
+    for(size_type j = k + 1; j < inner->count; ++j)
+      moveKey(inner, j, inner, j - 1);
+    for(size_type j = k + 2; j <= inner->count; ++j)
+      inner->children[j - 1] = inner->children[j];
+    --inner->count;
+
+    if(inner == root) {
+      if(inner->count == 0) {
+        root = inner->children[0];
+        root->parent = nullptr;
+        delete inner;
+      }
+      return;
+    }
+    if(inner->count < min_inner) rebalance(inner);
+  }
+
+  void rebalance(Inner* node)
+  {
+    Inner* parent = node->parent;
+    size_type i = childIndex(parent, node);
+    Inner* left = i > 0 ? static_cast<Inner*>(parent->children[i - 1]) : nullptr;
+    Inner* right = i < parent->count ? static_cast<Inner*>(parent->children[i + 1]) : nullptr;
+
+    if(left != nullptr && left->count > min_inner) { ///obrót w prawo przez rodzica
+      for(size_type j = node->count; j > 0; --j)
+        moveKey(node, j - 1, node, j);
+      for(size_type j = node->count + 1; j > 0; --j)
+        node->children[j] = node->children[j - 1];
+      moveKey(parent, i - 1, node, 0);
+      moveKey(left, left->count - 1, parent, i - 1);
+      node->children[0] = left->children[left->count];
+      node->children[0]->parent = node;
+      --left->count;
+      ++node->count;
+    }
+    else if(right != nullptr && right->count > min_inner) { ///obrót w lewo przez rodzica
+      moveKey(parent, i, node, node->count);
+      moveKey(right, 0, parent, i);
+      node->children[node->count + 1] = right->children[0];
+      node->children[node->count + 1]->parent = node;
+      ++node->count;
+      for(size_type j = 1; j < right->count; ++j)
+        moveKey(right, j, right, j - 1);
+      for(size_type j = 1; j <= right->count; ++j)
+        right->children[j - 1] = right->children[j];
+      --right->count;
+    }
+    else if(left != nullptr)  merge(left, node, i - 1);
+    else  merge(node, right, i);
+  }
+
+  void merge(Inner* left, Inner* right, size_type separator)
+  {
+    Inner* parent = left->parent;
+    new (left->key(left->count)) key_type(*parent->key(separator)); ///separator schodzi piętro niżej
+    for(size_type j = 0; j < right->count; ++j)
+      moveKey(right, j, left, left->count + 1 + j);
+    for(size_type j = 0; j <= right->count; ++j) {
+      left->children[left->count + 1 + j] = right->children[j];
+      right->children[j]->parent = left;
+    }
+    left->count += right->count + 1;
+    right->count = 0;
+    delete right;
+    removeFromInner(parent, separator);
+  }
+
+  void merge(Leaf* left, Leaf* right, size_type separator)
+  {
+    for(size_type j = 0; j < right->count; ++j)
+      moveSlot(right, j, left, left->count + j);
+    left->count += right->count;
+    right->count = 0;
+
+    left->next = right->next;
+    if(left->next != nullptr) left->next->prev = left;
+    else  tail = left;
+    delete right;
+    removeFromInner(left->parent, separator);
+  }
+
+  void rebalance(Leaf* leaf)
+  {
+    Inner* parent = leaf->parent;
+    size_type i = childIndex(parent, leaf);
+    Leaf* left = i > 0 ? static_cast<Leaf*>(parent->children[i - 1]) : nullptr;
+    Leaf* right = i < parent->count ? static_cast<Leaf*>(parent->children[i + 1]) : nullptr;
+
+    if(left != nullptr && left->count > min_leaf) { ///pożyczamy ostatni element lewego sąsiada
+      for(size_type j = leaf->count; j > 0; --j)
+        moveSlot(leaf, j - 1, leaf, j);
+      moveSlot(left, left->count - 1, leaf, 0);
+      --left->count;
+      ++leaf->count;
+      *parent->key(i - 1) = leaf->slot(0)->first;
+    }
+    else if(right != nullptr && right->count > min_leaf) { ///pożyczamy pierwszy element prawego sąsiada
+      moveSlot(right, 0, leaf, leaf->count);
+      for(size_type j = 1; j < right->count; ++j)
+        moveSlot(right, j, right, j - 1);
+      --right->count;
+      ++leaf->count;
+      *parent->key(i) = right->slot(0)->first;
+    }
+    else if(left != nullptr)  merge(left, leaf, i - 1);
+    else  merge(leaf, right, i);
+  }
+
+  void remove(Leaf* leaf, size_type pos)
+  {
+    leaf->slot(pos)->~value_type();
+    for(size_type j = pos + 1; j < leaf->count; ++j)
+      moveSlot(leaf, j, leaf, j - 1);
+    --leaf->count;
+    --size;
+
+    if(leaf == root) {
+      if(leaf->count == 0) erase();
+      return;
+    }
+    if(leaf->count < min_leaf) rebalance(leaf);
+  }
+
+public:
+  BTreeMap() : root(nullptr), head(nullptr), tail(nullptr), size(0) {}
+
+  BTreeMap(std::initializer_list<value_type> list) : BTreeMap()
+  {
+    for (auto it = list.begin(); it != list.end(); ++it)
+      operator[]((*it).first) = (*it).second;
+  }
+
+  BTreeMap(const BTreeMap& other) : BTreeMap() ///konstruktor kopiujący
+  {
+    *this = other;
+  }
+
+  BTreeMap(BTreeMap&& other) : BTreeMap()  ///konstruktor przenoszący
+  {
+    *this = std::move(other);
+  }
+
+  ~BTreeMap()
+  {
+    erase();
+  }
+
+  BTreeMap& operator=(const BTreeMap& other)  ///operator przypisania
+  {
+    if(this != &other) {
+      erase();
+      for (auto it = other.begin(); it != other.end(); ++it)
+        operator[]((*it).first) = (*it).second;
+    }
+    return *this;
+  }
+
+  BTreeMap& operator=(BTreeMap&& other) ///przenoszący operator przypisania
+  {
+    if(this != &other) {
+      erase();
+      std::swap(root, other.root);
+      std::swap(head, other.head);
+      std::swap(tail, other.tail);
+      std::swap(size, other.size);
+    }
+    return *this;
+  }
+
+  bool isEmpty() const
+  {
+    return !size;
+  }
+
+  mapped_type& operator[](const key_type& key)
+  {
+    auto position = insert(key);
+    return position.first->slot(position.second)->second;
+  }
+
+  const mapped_type& valueOf(const key_type& key) const
+  {
+    auto position = getNode(key);
+    if(position.first == nullptr)  throw std::out_of_range("ValueOf is out of range.");
+    return position.first->slot(position.second)->second;
+  }
+
+  mapped_type& valueOf(const key_type& key)
+  {
+    auto position = getNode(key);
+    if(position.first == nullptr)  throw std::out_of_range("ValueOf is out of range.");
+    return position.first->slot(position.second)->second;
+  }
+
+  const_iterator find(const key_type& key) const
+  {
+    auto position = getNode(key);
+    return const_iterator(this, position.first, position.second);
+  }
+
+  iterator find(const key_type& key)
+  {
+    auto position = getNode(key);
+    return iterator(this, position.first, position.second);
+  }
+
+  void remove(const key_type& key)
+  {
+    remove(find(key));
+  }
+
+  void remove(const const_iterator& it)
+  {
+    if(this != it.tree || it == end())  throw std::out_of_range ("Remove is out of range.");
+    remove(it.leaf, it.index);
+  }
+
+  size_type getSize() const
+  {
+    return size;
+  }
+
+  bool operator==(const BTreeMap& other) const
+  {
+    if(size != other.size)  return false;
+    for(auto it = begin(), it2 = other.begin(); it != end(); ++it, ++it2) {
+      if(*it != *it2) return false;
+    }
+    return true;
+  }
+
+  bool operator!=(const BTreeMap& other) const
+  {
+    return !(*this == other);
+  }
+
+  iterator begin()
+  {
+    return iterator(this, head);
+  }
+
+  iterator end()
+  {
+    return iterator(this);
+  }
+
+  const_iterator cbegin() const
+  {
+    return const_iterator(this, head);
+  }
+
+  const_iterator cend() const
+  {
+    return const_iterator(this);
+  }
+
+  const_iterator begin() const
+  {
+    return cbegin();
+  }
+
+  const_iterator end() const
+  {
+    return cend();
+  }
+};
+
+template <typename KeyType, typename ValueType>
+class BTreeMap<KeyType, ValueType>::ConstIterator
+{
+public:
+  using reference = typename BTreeMap::const_reference;
+  using iterator_category = std::bidirectional_iterator_tag;
+  using value_type = typename BTreeMap::value_type;
+  using pointer = const typename BTreeMap::value_type*;
+
+protected:
+  const BTreeMap *tree;
+  Leaf *leaf;
+  size_type index;
+  friend void BTreeMap<KeyType, ValueType>::remove(const const_iterator&);
+
+public:
+  explicit ConstIterator(const BTreeMap *tree = nullptr, Leaf *leaf = nullptr, size_type index = 0)
+  : tree(tree), leaf(leaf), index(index) {}
+
+  ConstIterator(const ConstIterator& other)
+  : ConstIterator(other.tree, other.leaf, other.index) {}
+
+  ConstIterator& operator++()
+  {
+    if(leaf == nullptr || tree == nullptr)  throw std::out_of_range("Operator++ is out of range.");
+    if(++index == leaf->count) { ///koniec liścia - przechodzimy do następnego
+      leaf = leaf->next;
+      index = 0;
+    }
+    return *this;
+  }
+
+  ConstIterator operator++(int)
+  {
+    auto result = *this;
+    ConstIterator::operator++();
+    return result;
+  }
+
+  ConstIterator& operator--()
+  {
+    if(tree == nullptr || tree->tail == nullptr)  throw std::out_of_range("Operator-- is out of range.");
+    if(leaf == nullptr) {
+      leaf = tree->tail;
+      index = leaf->count - 1;
+    }
+    else if(index > 0)  --index;
+    else if(leaf->prev != nullptr) {
+      leaf = leaf->prev;
+      index = leaf->count - 1;
+    }
+    else  throw std::out_of_range("Operator-- is out of range.");
+    return *this;
+  }
+
+  ConstIterator operator--(int)
+  {
+    auto result = *this;
+    ConstIterator::operator--();
+    return result;
+  }
+
+  reference operator*() const
+  {
+    if(leaf == nullptr || tree == nullptr)  throw std::out_of_range("Operator* is out of range.");
+    return *leaf->slot(index);
+  }
+
+  pointer operator->() const
+  {
+    return &this->operator*();
+  }
+
+  bool operator==(const ConstIterator& other) const
+  {
+    return tree == other.tree && leaf == other.leaf && index == other.index;
+  }
+
+  bool operator!=(const ConstIterator& other) const
+  {
+    return !(*this == other);
+  }
+};
+
+template <typename KeyType, typename ValueType>
+class BTreeMap<KeyType, ValueType>::Iterator : public BTreeMap<KeyType, ValueType>::ConstIterator
+{
+public:
+  using reference = typename BTreeMap::reference;
+  using pointer = typename BTreeMap::value_type*;
+
+  explicit Iterator(BTreeMap *tree = nullptr, Leaf *leaf = nullptr, size_type index = 0)
+  : ConstIterator(tree, leaf, index) {}
+
+  Iterator(const ConstIterator& other)
+  : ConstIterator(other) {}
+
+  Iterator& operator++()
+  {
+    ConstIterator::operator++();
+    return *this;
+  }
+
+  Iterator operator++(int)
+  {
+    auto result = *this;
+    ConstIterator::operator++();
+    return result;
+  }
+
+  Iterator& operator--()
+  {
+    ConstIterator::operator--();
+    return *this;
+  }
+
+  Iterator operator--(int)
+  {
+    auto result = *this;
+    ConstIterator::operator--();
+    return result;
+  }
+
+  pointer operator->() const
+  {
+    return &this->operator*();
+  }
+
+  reference operator*() const
+  {
+    // ugly cast, yet reduces code duplication.
+    return const_cast<reference>(ConstIterator::operator*());
+  }
+};
+
+}
+
+#endif /* AISDI_MAPS_BTREEMAP_H */
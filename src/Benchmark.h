@@ -0,0 +1,481 @@
+#ifndef AISDI_MAPS_BENCHMARK_H
+#define AISDI_MAPS_BENCHMARK_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <iomanip>
+#include <ostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace aisdi
+{
+
+namespace bench
+{
+
+using Clock = std::chrono::steady_clock;
+
+template <typename T>
+inline void doNotOptimize(const T& value) ///wynik nie może zostać wyrzucony przez optymalizator
+{
+#if defined(__GNUC__)
+  asm volatile("" : : "r,m"(value) : "memory");
+#else
+  static volatile const T* sink;
+  sink = &value;
+#endif
+}
+
+inline double seconds(Clock::time_point start, Clock::time_point end)
+{
+  return std::chrono::duration<double>(end - start).count();
+}
+
+struct Summary ///statystyki czasu jednej operacji w nanosekundach
+{
+  std::size_t samples = 0;
+  double median = 0;
+  double p99 = 0;
+  double p999 = 0;
+  double max = 0;
+  double mean = 0;
+  double min = 0;
+};
+
+inline double percentile(const std::vector<double>& sorted, double fraction)
+{
+  if(sorted.empty()) return 0;
+  std::size_t index = static_cast<std::size_t>(std::ceil(fraction * sorted.size()));
+  return sorted[index == 0 ? 0 : index - 1];
+}
+
+inline Summary summarize(std::vector<double> values)
+{
+  Summary summary;
+  if(values.empty()) return summary;
+  std::sort(values.begin(), values.end());
+  summary.samples = values.size();
+  summary.median = percentile(values, 0.5);
+  summary.p99 = percentile(values, 0.99);
+  summary.p999 = percentile(values, 0.999);
+  summary.max = values.back();
+  summary.min = values.front();
+  double total = 0;
+  for(auto it = values.begin(); it != values.end(); ++it) total += *it;
+  summary.mean = total / values.size();
+  return summary;
+}
+
+class Sampler ///mierzy paczki po batch operacji, zapisuje ns na operację dla każdej paczki
+{
+public:
+  explicit Sampler(std::size_t batch) : batch(batch == 0 ? 1 : batch) {}
+
+  template <typename Operation>
+  double run(std::size_t count, Operation operation, bool record)
+  {
+    auto start = Clock::now();
+    auto last = start;
+    for(std::size_t i = 0; i < count; ) {
+      std::size_t stop = std::min(count, i + batch);
+      std::size_t done = stop - i;
+      for(; i < stop; ++i) operation(i);
+      if(record) {
+        auto now = Clock::now();
+        batches.push_back(std::chrono::duration<double, std::nano>(now - last).count() / done);
+        last = now;
+      }
+    }
+    double total = seconds(start, Clock::now());
+    if(record && count > 0) totals.push_back(total / count * 1e9);
+    return total;
+  }
+
+  template <typename Operation>
+  double runBulk(std::size_t elements, Operation operation, bool record) ///jedna operacja na całej mapie, ns na element
+  {
+    auto start = Clock::now();
+    operation();
+    double total = seconds(start, Clock::now());
+    if(record && elements > 0) {
+      batches.push_back(total / elements * 1e9);
+      totals.push_back(total / elements * 1e9);
+    }
+    return total;
+  }
+
+  void merge(const Sampler& other) ///łączy próbki z samplerów poszczególnych wątków
+  {
+    batches.insert(batches.end(), other.batches.begin(), other.batches.end());
+    totals.insert(totals.end(), other.totals.begin(), other.totals.end());
+  }
+
+  Summary summary() const
+  {
+    return summarize(batches);
+  }
+
+  double medianTotal() const ///mediana średniego ns/op z całych prób
+  {
+    return summarize(totals).median;
+  }
+
+private:
+  std::size_t batch;
+  std::vector<double> batches;
+  std::vector<double> totals;
+};
+
+///czasy pojedynczych operacji bez przechowywania każdej próbki: kubełki po 16 na każdą potęgę dwójki,
+///więc percentyle są dokładne do ~6%; minimum, maksimum i średnia - dokładne
+class Histogram
+{
+public:
+  Histogram() : counts(slots, 0), samples(0), total(0), smallest(0), largest(0) {}
+
+  void add(double ns)
+  {
+    std::uint64_t value = ns > 0 ? static_cast<std::uint64_t>(ns) : 0;
+    ++counts[slot(value)];
+    if(samples == 0 || ns < smallest) smallest = ns;
+    if(ns > largest) largest = ns;
+    ++samples;
+    total += ns;
+  }
+
+  void merge(const Histogram& other)
+  {
+    for(std::size_t i = 0; i < slots; ++i) counts[i] += other.counts[i];
+    if(other.samples > 0 && (samples == 0 || other.smallest < smallest)) smallest = other.smallest;
+    if(other.largest > largest) largest = other.largest;
+    samples += other.samples;
+    total += other.total;
+  }
+
+  double percentile(double fraction) const ///górna granica kubełka, w którym wypada percentyl
+  {
+    std::uint64_t rank = static_cast<std::uint64_t>(std::ceil(fraction * samples));
+    std::uint64_t seen = 0;
+    for(std::size_t i = 0; i < slots; ++i) {
+      seen += counts[i];
+      if(seen >= rank && seen > 0) return std::min(largest, static_cast<double>(lowest(i + 1)));
+    }
+    return largest;
+  }
+
+  Summary summary() const
+  {
+    Summary summary;
+    if(samples == 0) return summary;
+    summary.samples = samples;
+    summary.median = percentile(0.5);
+    summary.p99 = percentile(0.99);
+    summary.p999 = percentile(0.999);
+    summary.max = largest;
+    summary.mean = total / samples;
+    summary.min = smallest;
+    return summary;
+  }
+
+  void write(std::ostream& out) const ///potęgi dwójki z liczbą operacji i udziałem procentowym
+  {
+    for(std::size_t power = 0; power < 64; ++power) {
+      std::uint64_t count = 0;
+      for(std::size_t i = slot(std::uint64_t(1) << power) ; i < slots && i < slot(std::uint64_t(2) << power); ++i)
+        count += counts[i];
+      if(power == 0) count += counts[0];
+      if(count == 0) continue;
+      out << "    < " << std::setw(12) << (std::uint64_t(2) << power) << " ns " << std::setw(12) << count
+          << std::fixed << std::setprecision(4) << std::setw(10) << 100.0 * count / samples << "%\n";
+    }
+  }
+
+private:
+  static const std::size_t slots = 16 + 60 * 16;
+
+  static std::size_t slot(std::uint64_t value)
+  {
+    if(value < 16) return static_cast<std::size_t>(value);
+    unsigned exponent = 63;
+    while(!(value >> exponent)) --exponent;
+    return 16 + (exponent - 4) * 16 + static_cast<std::size_t>((value >> (exponent - 4)) & 15);
+  }
+
+  static std::uint64_t lowest(std::size_t index) ///najmniejsza wartość trafiająca do kubełka index
+  {
+    if(index < 16) return index;
+    std::size_t exponent = (index - 16) / 16 + 4;
+    return (16 + (index - 16) % 16) << (exponent - 4);
+  }
+
+  std::vector<std::uint64_t> counts;
+  std::uint64_t samples;
+  double total;
+  double smallest;
+  double largest;
+};
+
+template <typename Operation>
+void timeEach(Histogram& histogram, std::size_t count, Operation operation, bool record) ///każda operacja osobno
+{
+  for(std::size_t i = 0; i < count; ++i) {
+    auto start = Clock::now();
+    operation(i);
+    auto stop = Clock::now();
+    if(record) histogram.add(std::chrono::duration<double, std::nano>(stop - start).count());
+  }
+}
+
+class Zipfian ///generator Graya i in. (jak w YCSB): rangi 0..n-1, ranga 0 najczęstsza
+{
+public:
+  Zipfian(std::size_t n, double theta = 0.99)
+  : n(n), theta(theta), zetan(zeta(n, theta)), alpha(1.0 / (1.0 - theta)),
+    eta((1.0 - std::pow(2.0 / n, 1.0 - theta)) / (1.0 - zeta(2, theta) / zetan))
+  {}
+
+  template <typename Engine>
+  std::size_t operator()(Engine& engine)
+  {
+    double u = std::uniform_real_distribution<double>(0.0, 1.0)(engine);
+    double uz = u * zetan;
+    if(uz < 1.0) return 0;
+    if(uz < 1.0 + std::pow(0.5, theta)) return n > 1 ? 1 : 0;
+    std::size_t rank = static_cast<std::size_t>(n * std::pow(eta * u - eta + 1.0, alpha));
+    return rank < n ? rank : n - 1;
+  }
+
+private:
+  static double zeta(std::size_t n, double theta)
+  {
+    double sum = 0;
+    for(std::size_t i = 1; i <= n; ++i) sum += 1.0 / std::pow(static_cast<double>(i), theta);
+    return sum;
+  }
+
+  std::size_t n;
+  double theta;
+  double zetan;
+  double alpha;
+  double eta;
+};
+
+template <typename T>
+struct Generator;
+
+template <>
+struct Generator<int>
+{
+  static const char* name() { return "int"; }
+  static int make(std::size_t i) { return static_cast<int>(i); }
+};
+
+template <>
+struct Generator<std::uint64_t>
+{
+  static const char* name() { return "uint64"; }
+  static std::uint64_t make(std::size_t i) { return i; }
+};
+
+template <>
+struct Generator<std::string> ///stała szerokość, więc porządek leksykograficzny = numeryczny
+{
+  static const char* name() { return "string"; }
+  static std::string make(std::size_t i)
+  {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "key-%016llu", static_cast<unsigned long long>(i));
+    return buffer;
+  }
+};
+
+enum class Distribution { Sorted, Shuffled, Zipfian };
+
+inline const char* name(Distribution distribution)
+{
+  switch(distribution) {
+    case Distribution::Sorted: return "sorted";
+    case Distribution::Shuffled: return "shuffled";
+    default: return "zipfian";
+  }
+}
+
+inline Distribution parseDistribution(const std::string& text)
+{
+  if(text == "sorted") return Distribution::Sorted;
+  if(text == "shuffled") return Distribution::Shuffled;
+  if(text == "zipfian") return Distribution::Zipfian;
+  throw std::invalid_argument("Unknown distribution: " + text);
+}
+
+///obecne klucze to parzyste numery, chybione nieparzyste - chybienia lądują między istniejącymi kluczami
+template <typename K, typename V>
+struct Workload ///dane jednego przypadku, wspólne dla wszystkich map i prób
+{
+  std::vector<K> inserts;      ///kolejność wstawiania
+  std::vector<V> values;
+  std::vector<K> hits;         ///wyszukiwania istniejących kluczy
+  std::vector<K> misses;       ///wyszukiwania nieistniejących kluczy
+  std::vector<K> mixed;        ///odczyty i zapisy przemieszane
+  std::vector<char> writes;    ///czy operacja mixed[i] jest zapisem
+  std::vector<K> removals;
+
+  Workload(std::size_t n, Distribution distribution, std::uint64_t seed, double write_ratio)
+  {
+    std::mt19937_64 engine(seed);
+    std::vector<std::size_t> order(n);
+    for(std::size_t i = 0; i < n; ++i) order[i] = i;
+
+    auto shuffled = [&]() {
+      std::vector<std::size_t> result(order);
+      if(distribution != Distribution::Sorted) std::shuffle(result.begin(), result.end(), engine);
+      return result;
+    };
+
+    std::vector<std::size_t> insert_order = shuffled();
+    inserts.reserve(n);
+    values.reserve(n);
+    for(std::size_t i = 0; i < n; ++i) {
+      inserts.push_back(Generator<K>::make(2 * insert_order[i]));
+      values.push_back(Generator<V>::make(insert_order[i]));
+    }
+
+    std::vector<std::size_t> probes;
+    if(distribution == Distribution::Zipfian) { ///gorące klucze rozrzucone po całym zbiorze
+      Zipfian zipf(n);
+      std::vector<std::size_t> scramble = shuffled();
+      probes.reserve(n);
+      for(std::size_t i = 0; i < n; ++i) probes.push_back(scramble[zipf(engine)]);
+    }
+    else  probes = shuffled();
+
+    hits.reserve(n);
+    for(std::size_t i = 0; i < n; ++i) hits.push_back(Generator<K>::make(2 * probes[i]));
+
+    std::vector<std::size_t> miss_order = shuffled();
+    misses.reserve(n);
+    for(std::size_t i = 0; i < n; ++i) misses.push_back(Generator<K>::make(2 * miss_order[i] + 1));
+
+    std::bernoulli_distribution coin(write_ratio);
+    mixed = hits;
+    writes.reserve(n);
+    for(std::size_t i = 0; i < n; ++i) writes.push_back(coin(engine) ? 1 : 0);
+
+    std::vector<std::size_t> remove_order = shuffled();
+    removals.reserve(n);
+    for(std::size_t i = 0; i < n; ++i) removals.push_back(Generator<K>::make(2 * remove_order[i]));
+  }
+};
+
+struct Record ///jeden wiersz raportu
+{
+  std::string suite;
+  std::string map;
+  std::string key;
+  std::string value;
+  std::string distribution;
+  std::size_t size;
+  unsigned threads;
+  std::string phase;
+  Summary batch;
+  double ops_per_sec;
+};
+
+enum class Format { Text, Csv, Json };
+
+inline Format parseFormat(const std::string& text)
+{
+  if(text == "text") return Format::Text;
+  if(text == "csv") return Format::Csv;
+  if(text == "json") return Format::Json;
+  throw std::invalid_argument("Unknown format: " + text);
+}
+
+class Reporter
+{
+public:
+  Reporter(std::ostream& out, Format format) : out(out), format(format), rows(0) {}
+
+  void add(const Record& record)
+  {
+    if(rows++ == 0) header();
+    switch(format) {
+      case Format::Text:
+        out << std::left << std::setw(10) << record.suite << std::setw(12) << record.map
+            << std::setw(8) << record.key << std::setw(8) << record.value << std::setw(10) << record.distribution
+            << std::right << std::setw(11) << record.size << std::setw(4) << record.threads << "  "
+            << std::left << std::setw(9) << record.phase << std::right << std::fixed << std::setprecision(1)
+            << std::setw(10) << record.batch.median << std::setw(10) << record.batch.p99
+            << std::setw(10) << record.batch.p999 << std::setw(12) << record.batch.max
+            << std::setw(10) << record.batch.mean << std::setw(14) << std::setprecision(0) << record.ops_per_sec << "\n";
+        break;
+      case Format::Csv:
+        out << record.suite << ',' << record.map << ',' << record.key << ',' << record.value << ','
+            << record.distribution << ',' << record.size << ',' << record.threads << ',' << record.phase << ','
+            << record.batch.samples << ',' << record.batch.median << ',' << record.batch.p99 << ','
+            << record.batch.p999 << ',' << record.batch.max << ',' << record.batch.mean << ',' << record.batch.min << ',' << record.ops_per_sec << "\n";
+        break;
+      case Format::Json:
+        out << (rows > 1 ? ",\n" : "") << "  {\"suite\": \"" << record.suite << "\", \"map\": \"" << record.map
+            << "\", \"key\": \"" << record.key << "\", \"value\": \"" << record.value
+            << "\", \"distribution\": \"" << record.distribution << "\", \"size\": " << record.size
+            << ", \"threads\": " << record.threads << ", \"phase\": \"" << record.phase
+            << "\", \"samples\": " << record.batch.samples << ", \"median_ns\": " << record.batch.median
+            << ", \"p99_ns\": " << record.batch.p99 << ", \"p999_ns\": " << record.batch.p999
+            << ", \"max_ns\": " << record.batch.max << ", \"mean_ns\": " << record.batch.mean
+            << ", \"min_ns\": " << record.batch.min << ", \"ops_per_sec\": " << record.ops_per_sec << "}";
+        break;
+    }
+    out.flush();
+  }
+
+  void histogram(const Histogram& histogram) ///rozkład pod wierszem - tylko w formacie tekstowym
+  {
+    if(format != Format::Text) return;
+    histogram.write(out);
+    out.flush();
+  }
+
+  void finish()
+  {
+    if(format == Format::Json) out << (rows == 0 ? "[" : "") << "\n]\n";
+  }
+
+private:
+  void header()
+  {
+    switch(format) {
+      case Format::Text:
+        out << std::left << std::setw(10) << "suite" << std::setw(12) << "map" << std::setw(8) << "key"
+            << std::setw(8) << "value" << std::setw(10) << "dist" << std::right << std::setw(11) << "size"
+            << std::setw(4) << "thr" << "  " << std::left << std::setw(9) << "phase" << std::right
+            << std::setw(10) << "med ns" << std::setw(10) << "p99 ns" << std::setw(10) << "p99.9 ns"
+            << std::setw(12) << "max ns" << std::setw(10) << "mean ns"
+            << std::setw(14) << "ops/s" << "\n";
+        break;
+      case Format::Csv:
+        out << "suite,map,key,value,distribution,size,threads,phase,samples,median_ns,p99_ns,p999_ns,max_ns,mean_ns,min_ns,ops_per_sec\n";
+        break;
+      case Format::Json:
+        out << "[\n";
+        break;
+    }
+  }
+
+  std::ostream& out;
+  Format format;
+  std::size_t rows;
+};
+
+}
+
+}
+
+#endif /* AISDI_MAPS_BENCHMARK_H */
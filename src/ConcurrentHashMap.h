@@ -0,0 +1,226 @@
+#ifndef AISDI_MAPS_CONCURRENTHASHMAP_H
+#define AISDI_MAPS_CONCURRENTHASHMAP_H
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "HashMap.h"
+
+namespace aisdi
+{
+
+#if __cplusplus >= 201703L
+using SharedMutex = std::shared_mutex;
+#else
+using SharedMutex = std::shared_timed_mutex;
+#endif
+
+///HashMap podzielona na niezależnie blokowane fragmenty (shardy): odczyty biorą blokadę współdzieloną,
+///zapisy wyłączną, ale tylko na swój fragment; iteratorów brak - wartości wychodzą na zewnątrz jako kopie
+template <typename KeyType, typename ValueType,
+          typename Hash = aisdi::Hash<KeyType>, typename KeyEqual = EqualTo,
+          typename Allocator = std::allocator<std::pair<const KeyType, ValueType>>>
+class ConcurrentHashMap
+{
+public:
+  using key_type = KeyType;
+  using mapped_type = ValueType;
+  using value_type = std::pair<const key_type, mapped_type>;
+  using size_type = std::size_t;
+  using allocator_type = Allocator;
+  using hasher = Hash;
+  using key_equal = KeyEqual;
+  using map_type = HashMap<KeyType, ValueType, Hash, KeyEqual, Allocator>;
+
+private:
+  struct Shard ///każdy shard alokowany osobno; odstęp przed blokadą - nie dzieli linii pamięci podręcznej z sąsiadem
+  {
+    char padding[64];
+    mutable SharedMutex mutex;
+    map_type map;
+
+    Shard(size_type buckets, const Hash& hash, const KeyEqual& equal, const Allocator& allocator)
+      : map(buckets, hash, equal, allocator) {}
+  };
+
+  using ReadLock = std::shared_lock<SharedMutex>;
+  using WriteLock = std::unique_lock<SharedMutex>;
+
+  std::vector<std::unique_ptr<Shard>> shards;
+  size_type mask;
+  hasher hash;
+
+  static size_type defaultShards()
+  {
+    size_type threads = std::thread::hardware_concurrency();
+    return 4 * (threads == 0 ? 4 : threads);
+  }
+
+  static size_type roundShards(size_type count)
+  {
+    size_type result = 1;
+    while(result < count) result *= 2;
+    return result;
+  }
+
+  ///dolne bity skrótu - górne wybierają kubełek wewnątrz shardu (fibonacciReduce), więc się nie powtarzają.
+  ///Pod ReadLock tylko wersja const: nie-const find w HashMap przesuwa migrację, czyli zmienia mapę
+  const Shard& shardFor(const key_type& key) const
+  {
+    return *shards[hash(key) & mask];
+  }
+
+  Shard& shardFor(const key_type& key) ///tylko pod WriteLock
+  {
+    return *shards[hash(key) & mask];
+  }
+
+public:
+  explicit ConcurrentHashMap(size_type shard_count = 0, size_type buckets = 16,
+                             const Hash& hash = Hash(), const KeyEqual& equal = KeyEqual(),
+                             const Allocator& allocator = Allocator())
+    : mask(roundShards(shard_count == 0 ? defaultShards() : shard_count) - 1), hash(hash)
+  {
+    shards.reserve(mask + 1);
+    for(size_type i = 0; i <= mask; ++i)
+      shards.emplace_back(new Shard(buckets, hash, equal, allocator));
+  }
+
+  ConcurrentHashMap(const ConcurrentHashMap&) = delete;
+  ConcurrentHashMap& operator=(const ConcurrentHashMap&) = delete;
+
+  template <typename M>
+  bool insert_or_assign(const key_type& key, M&& mapped) ///true, jeśli klucz został dodany
+  {
+    Shard& shard = shardFor(key);
+    WriteLock lock(shard.mutex);
+    return shard.map.insert_or_assign(key, std::forward<M>(mapped)).second;
+  }
+
+  template <typename M>
+  bool insert_or_assign(key_type&& key, M&& mapped)
+  {
+    Shard& shard = shardFor(key);
+    WriteLock lock(shard.mutex);
+    return shard.map.insert_or_assign(std::move(key), std::forward<M>(mapped)).second;
+  }
+
+  template <typename... Args>
+  bool try_emplace(const key_type& key, Args&&... args)
+  {
+    Shard& shard = shardFor(key);
+    WriteLock lock(shard.mutex);
+    return shard.map.try_emplace(key, std::forward<Args>(args)...).second;
+  }
+
+  bool find(const key_type& key, mapped_type& out) const ///kopiuje wartość pod blokadą współdzieloną
+  {
+    const Shard& shard = shardFor(key);
+    ReadLock lock(shard.mutex);
+    auto it = shard.map.find(key);
+    if(it == shard.map.end()) return false;
+    out = it->second;
+    return true;
+  }
+
+  bool contains(const key_type& key) const
+  {
+    const Shard& shard = shardFor(key);
+    ReadLock lock(shard.mutex);
+    return shard.map.find(key) != shard.map.end();
+  }
+
+  template <typename Function>
+  bool visit(const key_type& key, Function function) const ///function(const mapped_type&) pod blokadą współdzieloną
+  {
+    const Shard& shard = shardFor(key);
+    ReadLock lock(shard.mutex);
+    auto it = shard.map.find(key);
+    if(it == shard.map.end()) return false;
+    function(it->second);
+    return true;
+  }
+
+  template <typename Function>
+  bool update(const key_type& key, Function function) ///function(mapped_type&) pod blokadą wyłączną
+  {
+    Shard& shard = shardFor(key);
+    WriteLock lock(shard.mutex);
+    auto it = shard.map.find(key);
+    if(it == shard.map.end()) return false;
+    function(it->second);
+    return true;
+  }
+
+  ///factory() wywoływana co najwyżej raz i tylko gdy klucza brak; zwraca kopię wartości z mapy
+  template <typename Factory>
+  mapped_type compute_if_absent(const key_type& key, Factory factory)
+  {
+    Shard& shard = shardFor(key);
+    {
+      ReadLock lock(shard.mutex); ///częsty przypadek - klucz już jest, wystarczy blokada współdzielona
+      const map_type& map = shard.map;
+      auto it = map.find(key);
+      if(it != map.end()) return it->second;
+    }
+    WriteLock lock(shard.mutex);
+    auto it = shard.map.find(key);
+    if(it == shard.map.end()) it = shard.map.try_emplace(key, factory()).first;
+    return it->second;
+  }
+
+  size_type erase(const key_type& key)
+  {
+    Shard& shard = shardFor(key);
+    WriteLock lock(shard.mutex);
+    auto it = shard.map.find(key);
+    if(it == shard.map.end()) return 0;
+    shard.map.remove(it);
+    return 1;
+  }
+
+  template <typename Function>
+  void for_each(Function function) const ///function(const value_type&); shardy blokowane kolejno, nie naraz
+  {
+    for(auto it = shards.begin(); it != shards.end(); ++it) {
+      ReadLock lock((*it)->mutex);
+      const map_type& map = (*it)->map;
+      for(auto node = map.begin(); node != map.end(); ++node)
+        function(*node);
+    }
+  }
+
+  size_type getSize() const ///przy równoległych zapisach wynik jest tylko przybliżony
+  {
+    size_type result = 0;
+    for(auto it = shards.begin(); it != shards.end(); ++it) {
+      ReadLock lock((*it)->mutex);
+      result += (*it)->map.getSize();
+    }
+    return result;
+  }
+
+  bool isEmpty() const
+  {
+    return getSize() == 0;
+  }
+
+  size_type shard_count() const
+  {
+    return shards.size();
+  }
+
+  hasher hash_function() const
+  {
+    return hash;
+  }
+};
+
+}
+
+#endif /* AISDI_MAPS_CONCURRENTHASHMAP_H */
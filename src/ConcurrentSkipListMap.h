@@ -0,0 +1,515 @@
+#ifndef AISDI_MAPS_CONCURRENTSKIPLISTMAP_H
+#define AISDI_MAPS_CONCURRENTSKIPLISTMAP_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "Epoch.h"
+#include "Functional.h"
+
+namespace aisdi
+{
+
+///uporządkowana mapa bez blokad dla wielu wątków: lista z przeskokami, wstawianie i usuwanie przez CAS.
+///Usunięcie najpierw oznacza węzeł (najmłodszy bit wskaźnika na następnik), potem odcina go każde
+///przechodzące wyszukiwanie; pamięć wraca przez epoki (EpochDomain). Wartość leży w osobnym bloku
+///podmienianym atomowo, więc odczyt zawsze widzi całą wartość. Wartości wychodzą na zewnątrz jako kopie,
+///iteratory są słabo spójne (jak w ConcurrentHashMap - bez migawki) i trzymają epokę, dopóki żyją
+template <typename KeyType, typename ValueType, typename Compare = Less>
+class ConcurrentSkipListMap
+{
+public:
+  using key_type = KeyType;
+  using mapped_type = ValueType;
+  using value_type = std::pair<const key_type, mapped_type>;
+  using size_type = std::size_t;
+  using key_compare = Compare;
+  using reference = std::pair<const key_type&, const mapped_type&>;
+  using const_reference = reference;
+
+  class ConstIterator;
+  using const_iterator = ConstIterator;
+  using iterator = ConstIterator;
+
+private:
+  enum { MaxLevel = 16 };                 ///przy p = 1/4 wystarcza na ~4^16 elementów
+  enum : std::uintptr_t { Mark = 1 };     ///węzeł usunięty na tym poziomie
+
+  using Link = std::atomic<std::uintptr_t>;
+
+  struct Node ///po nim w tej samej alokacji level wskaźników na następniki
+  {
+    const key_type key;
+    std::atomic<mapped_type*> value;
+    std::atomic<int> owners;  ///wstawiający i usuwający; ostatni, który skończy, oddaje węzeł epokom
+    const int level;
+
+    template <typename K>
+    Node(K&& key, mapped_type* value, int level)
+      : key(std::forward<K>(key)), value(value), owners(2), level(level) {}
+
+    Link* links()
+    {
+      return reinterpret_cast<Link*>(this + 1);
+    }
+  };
+
+  Link head[MaxLevel];
+  std::atomic<size_type> size;
+  key_compare compare;
+  mutable EpochDomain epochs;
+
+  template <typename K> ///wyszukiwanie po typie porównywalnym z kluczem, bez tworzenia key_type
+  using EnableLookup = typename std::enable_if<IsTransparent<key_compare>::value
+                                               && !std::is_convertible<const K&, const_iterator>::value>::type;
+
+  static Node* pointerOf(std::uintptr_t link)
+  {
+    return reinterpret_cast<Node*>(link & ~std::uintptr_t(Mark));
+  }
+
+  static bool isMarked(std::uintptr_t link)
+  {
+    return (link & Mark) != 0;
+  }
+
+  static std::uintptr_t linkOf(Node* node)
+  {
+    return reinterpret_cast<std::uintptr_t>(node);
+  }
+
+  static int randomLevel() ///p = 1/4 na każdy kolejny poziom, jak w Redisie
+  {
+    static thread_local std::uint64_t state = mix(reinterpret_cast<std::uintptr_t>(&state));
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    std::uint64_t bits = state;
+    int level = 1;
+    while(level < MaxLevel && (bits & 3) == 0) {
+      ++level;
+      bits >>= 2;
+    }
+    return level;
+  }
+
+  template <typename K, typename... Args>
+  static Node* createNode(int level, K&& key, Args&&... args)
+  {
+    std::unique_ptr<mapped_type> value(new mapped_type(std::forward<Args>(args)...));
+    void* memory = ::operator new(sizeof(Node) + level * sizeof(Link));
+    Node* node;
+    try {
+      node = new (memory) Node(std::forward<K>(key), value.get(), level);
+    }
+    catch(...) {
+      ::operator delete(memory);
+      throw;
+    }
+    value.release();
+    for(int i = 0; i < level; ++i)  new (node->links() + i) Link(0);
+    return node;
+  }
+
+  static void destroyNode(void* pointer)
+  {
+    Node* node = static_cast<Node*>(pointer);
+    delete node->value.load(std::memory_order_relaxed);
+    node->~Node();
+    ::operator delete(pointer);
+  }
+
+  static void destroyValue(void* pointer)
+  {
+    delete static_cast<mapped_type*>(pointer);
+  }
+
+  ///jedno przejście od góry: preds[i] - wskaźniki poprzednika na poziomie i (głowa albo links() węzła),
+  ///succs[i] - pierwszy węzeł z kluczem >= key. Oznaczone węzły po drodze odcina; false, gdy CAS odcięcia
+  ///przegrał z innym wątkiem i trzeba zacząć od nowa
+  template <typename K>
+  bool searchOnce(const K& key, Link** preds, Node** succs) const
+  {
+    Link* pred = const_cast<Link*>(head);
+    for(int level = MaxLevel - 1; level >= 0; --level) {
+      Node* curr = pointerOf(pred[level].load(std::memory_order_acquire));
+      while(curr != nullptr) {
+        std::uintptr_t succ = curr->links()[level].load(std::memory_order_acquire);
+        if(isMarked(succ)) {
+          std::uintptr_t expected = linkOf(curr);
+          if(!pred[level].compare_exchange_strong(expected, succ & ~std::uintptr_t(Mark), std::memory_order_acq_rel))
+            return false;
+          curr = pointerOf(succ);
+          continue;
+        }
+        if(!compare(curr->key, key))  break;
+        pred = curr->links();
+        curr = pointerOf(succ);
+      }
+      preds[level] = pred;
+      succs[level] = curr;
+    }
+    return true;
+  }
+
+  template <typename K>
+  bool search(const K& key, Link** preds, Node** succs) const ///true, gdy succs[0] ma klucz key
+  {
+    while(!searchOnce(key, preds, succs)) {}
+    return succs[0] != nullptr && !compare(key, succs[0]->key);
+  }
+
+  ///pierwszy nieusunięty węzeł z kluczem >= key (albo > key); bez zapisów - dla czytelników
+  template <typename K>
+  Node* lowerNode(const K& key, bool strict) const
+  {
+    const Link* pred = head;
+    Node* curr = nullptr;
+    for(int level = MaxLevel - 1; level >= 0; --level) {
+      curr = pointerOf(pred[level].load(std::memory_order_acquire));
+      while(curr != nullptr) {
+        std::uintptr_t succ = curr->links()[level].load(std::memory_order_acquire);
+        if(!isMarked(succ)) {
+          if(strict ? compare(key, curr->key) : !compare(curr->key, key))  break;
+          pred = curr->links();
+        }
+        curr = pointerOf(succ);
+      }
+    }
+    return curr;
+  }
+
+  template <typename K>
+  Node* getNode(const K& key) const
+  {
+    Node* node = lowerNode(key, false);
+    return node != nullptr && !compare(key, node->key) ? node : nullptr;
+  }
+
+  static Node* nextLive(Node* node) ///następnik na poziomie 0 z pominięciem usuniętych
+  {
+    do {
+      node = pointerOf(node->links()[0].load(std::memory_order_acquire));
+    } while(node != nullptr && isMarked(node->links()[0].load(std::memory_order_acquire)));
+    return node;
+  }
+
+  void replaceValue(Node* node, mapped_type* value)
+  {
+    mapped_type* old = node->value.exchange(value, std::memory_order_acq_rel);
+    epochs.retire(old, &destroyValue);
+  }
+
+  ///wstawiający i usuwający kończą w dowolnej kolejności; ostatni odcina węzeł ze wszystkich poziomów -
+  ///wcześniej wstawiający mógł jeszcze dopinać wyższe poziomy - i dopiero wtedy oddaje go epokom
+  void release(Node* node)
+  {
+    if(node->owners.fetch_sub(1, std::memory_order_acq_rel) != 1)  return;
+    Link* preds[MaxLevel];
+    Node* succs[MaxLevel];
+    search(node->key, preds, succs);
+    epochs.retire(node, &destroyNode);
+  }
+
+  void linkUpper(Node* node, Link** preds, Node** succs) ///poziom 0 już wpięty; wyższe - dopóki węzeł nie jest usuwany
+  {
+    for(int level = 1; level < node->level; ++level)
+      for(;;) {
+        std::uintptr_t link = node->links()[level].load(std::memory_order_acquire);
+        if(isMarked(link))  return;
+        if(pointerOf(link) != succs[level]
+           && !node->links()[level].compare_exchange_strong(link, linkOf(succs[level]), std::memory_order_acq_rel))
+          return; ///jedyny inny zapis tutaj to oznaczenie przez usuwającego
+        std::uintptr_t expected = linkOf(succs[level]);
+        if(preds[level][level].compare_exchange_strong(expected, linkOf(node), std::memory_order_acq_rel))  break;
+        search(node->key, preds, succs);
+        if(succs[0] != node)  return; ///węzeł już usunięty i odcięty na poziomie 0
+      }
+  }
+
+  template <typename K, typename... Args>
+  bool insertNode(bool assign, K&& key, Args&&... args) ///true, gdy klucz został dodany
+  {
+    EpochDomain::Guard guard(epochs);
+    Link* preds[MaxLevel];
+    Node* succs[MaxLevel];
+    if(search(key, preds, succs)) {
+      if(assign)  replaceValue(succs[0], new mapped_type(std::forward<Args>(args)...));
+      return false;
+    }
+
+    Node* node = createNode(randomLevel(), std::forward<K>(key), std::forward<Args>(args)...);
+    for(;;) {
+      for(int level = 0; level < node->level; ++level)
+        node->links()[level].store(linkOf(succs[level]), std::memory_order_relaxed);
+      std::uintptr_t expected = linkOf(succs[0]);
+      if(preds[0][0].compare_exchange_strong(expected, linkOf(node), std::memory_order_acq_rel))  break;
+      if(search(node->key, preds, succs)) { ///w międzyczasie ktoś wstawił ten sam klucz
+        if(assign)  replaceValue(succs[0], node->value.exchange(nullptr, std::memory_order_relaxed));
+        destroyNode(node);
+        return false;
+      }
+    }
+    size.fetch_add(1, std::memory_order_relaxed);
+    linkUpper(node, preds, succs);
+    release(node);
+    return true;
+  }
+
+  template <typename K>
+  bool removeNode(const K& key)
+  {
+    EpochDomain::Guard guard(epochs);
+    Link* preds[MaxLevel];
+    Node* succs[MaxLevel];
+    if(!search(key, preds, succs))  return false;
+    Node* node = succs[0];
+    for(int level = node->level - 1; level > 0; --level) {
+      std::uintptr_t link = node->links()[level].load(std::memory_order_acquire);
+      while(!isMarked(link)
+            && !node->links()[level].compare_exchange_weak(link, link | Mark, std::memory_order_acq_rel)) {}
+    }
+    std::uintptr_t link = node->links()[0].load(std::memory_order_acquire);
+    for(;;) { ///oznaczenie poziomu 0 to chwila usunięcia; przegrany wie, że klucz usunął ktoś inny
+      if(isMarked(link))  return false;
+      if(node->links()[0].compare_exchange_weak(link, link | Mark, std::memory_order_acq_rel))  break;
+    }
+    size.fetch_sub(1, std::memory_order_relaxed);
+    release(node);
+    return true;
+  }
+
+public:
+  explicit ConcurrentSkipListMap(const Compare& compare = Compare())
+    : size(0), compare(compare)
+  {
+    for(int level = 0; level < MaxLevel; ++level)  head[level].store(0, std::memory_order_relaxed);
+  }
+
+  ConcurrentSkipListMap(const ConcurrentSkipListMap&) = delete;
+  ConcurrentSkipListMap& operator=(const ConcurrentSkipListMap&) = delete;
+
+  ~ConcurrentSkipListMap() ///żaden wątek nie może już korzystać z mapy; to, co czeka w epokach, zwolni epochs
+  {
+    for(Node* node = pointerOf(head[0].load(std::memory_order_acquire)); node != nullptr; ) {
+      Node* next = pointerOf(node->links()[0].load(std::memory_order_relaxed));
+      destroyNode(node);
+      node = next;
+    }
+  }
+
+  template <typename M>
+  bool insert_or_assign(const key_type& key, M&& mapped) ///true, jeśli klucz został dodany
+  {
+    return insertNode(true, key, std::forward<M>(mapped));
+  }
+
+  template <typename M>
+  bool insert_or_assign(key_type&& key, M&& mapped)
+  {
+    return insertNode(true, std::move(key), std::forward<M>(mapped));
+  }
+
+  template <typename... Args>
+  bool try_emplace(const key_type& key, Args&&... args)
+  {
+    return insertNode(false, key, std::forward<Args>(args)...);
+  }
+
+  template <typename... Args>
+  bool try_emplace(key_type&& key, Args&&... args)
+  {
+    return insertNode(false, std::move(key), std::forward<Args>(args)...);
+  }
+
+  bool find(const key_type& key, mapped_type& out) const ///kopiuje wartość pod ochroną epoki
+  {
+    EpochDomain::Guard guard(epochs);
+    Node* node = getNode(key);
+    if(node == nullptr)  return false;
+    out = *node->value.load(std::memory_order_acquire);
+    return true;
+  }
+
+  bool contains(const key_type& key) const
+  {
+    EpochDomain::Guard guard(epochs);
+    return getNode(key) != nullptr;
+  }
+
+  mapped_type valueOf(const key_type& key) const
+  {
+    EpochDomain::Guard guard(epochs);
+    Node* node = getNode(key);
+    if(node == nullptr)  throw std::out_of_range("ValueOf is out of range.");
+    return *node->value.load(std::memory_order_acquire);
+  }
+
+  bool remove(const key_type& key) ///true, jeśli to ten wywołujący usunął klucz
+  {
+    return removeNode(key);
+  }
+
+  template <typename K, typename = EnableLookup<K>>
+  bool find(const K& key, mapped_type& out) const
+  {
+    EpochDomain::Guard guard(epochs);
+    Node* node = getNode(key);
+    if(node == nullptr)  return false;
+    out = *node->value.load(std::memory_order_acquire);
+    return true;
+  }
+
+  template <typename K, typename = EnableLookup<K>>
+  bool contains(const K& key) const
+  {
+    EpochDomain::Guard guard(epochs);
+    return getNode(key) != nullptr;
+  }
+
+  template <typename K, typename = EnableLookup<K>>
+  bool remove(const K& key)
+  {
+    return removeNode(key);
+  }
+
+  const_iterator lower_bound(const key_type& key) const ///początek skanowania zakresu
+  {
+    EpochDomain::Guard guard(epochs);
+    return const_iterator(guard, lowerNode(key, false));
+  }
+
+  const_iterator upper_bound(const key_type& key) const
+  {
+    EpochDomain::Guard guard(epochs);
+    return const_iterator(guard, lowerNode(key, true));
+  }
+
+  template <typename K, typename = EnableLookup<K>>
+  const_iterator lower_bound(const K& key) const
+  {
+    EpochDomain::Guard guard(epochs);
+    return const_iterator(guard, lowerNode(key, false));
+  }
+
+  template <typename K, typename = EnableLookup<K>>
+  const_iterator upper_bound(const K& key) const
+  {
+    EpochDomain::Guard guard(epochs);
+    return const_iterator(guard, lowerNode(key, true));
+  }
+
+  size_type getSize() const ///przy równoległych zmianach wynik jest tylko przybliżony
+  {
+    return size.load(std::memory_order_relaxed);
+  }
+
+  bool isEmpty() const
+  {
+    return getSize() == 0;
+  }
+
+  key_compare key_comp() const
+  {
+    return compare;
+  }
+
+  const_iterator cbegin() const
+  {
+    EpochDomain::Guard guard(epochs);
+    Node* first = pointerOf(head[0].load(std::memory_order_acquire));
+    if(first != nullptr && isMarked(first->links()[0].load(std::memory_order_acquire)))  first = nextLive(first);
+    return const_iterator(guard, first);
+  }
+
+  const_iterator cend() const
+  {
+    return const_iterator();
+  }
+
+  const_iterator begin() const
+  {
+    return cbegin();
+  }
+
+  const_iterator end() const
+  {
+    return cend();
+  }
+};
+
+///iterator w przód po poziomie 0; widzi elementy obecne przez cały czas przejścia, a dodane lub usunięte
+///w trakcie - albo nie. Trzyma epokę (zwalnianie pamięci czeka), więc nie powinien żyć długo;
+///używać tylko w wątku, który go utworzył
+template <typename KeyType, typename ValueType, typename Compare>
+class ConcurrentSkipListMap<KeyType, ValueType, Compare>::ConstIterator
+{
+public:
+  using reference = typename ConcurrentSkipListMap::const_reference;
+  using iterator_category = std::forward_iterator_tag;
+  using value_type = typename ConcurrentSkipListMap::value_type;
+  using difference_type = std::ptrdiff_t;
+
+  struct pointer ///operator-> musi zwrócić coś, co trzyma parę referencji
+  {
+    reference value;
+    const reference* operator->() const { return &value; }
+  };
+
+private:
+  EpochDomain::Guard guard;
+  Node* node;
+
+public:
+  ConstIterator() : node(nullptr) {}
+
+  ConstIterator(const EpochDomain::Guard& guard, Node* node)
+  : guard(guard), node(node)
+  {}
+
+  ConstIterator& operator++()
+  {
+    if(node == nullptr)  throw std::out_of_range("Operator++ is out of range.");
+    node = nextLive(node);
+    return *this;
+  }
+
+  ConstIterator operator++(int)
+  {
+    auto result = *this;
+    operator++();
+    return result;
+  }
+
+  reference operator*() const ///wartość z chwili odczytu; referencja ważna, dopóki żyje iterator
+  {
+    if(node == nullptr)  throw std::out_of_range("Operator* is out of range.");
+    return reference(node->key, *node->value.load(std::memory_order_acquire));
+  }
+
+  pointer operator->() const
+  {
+    return pointer{ operator*() };
+  }
+
+  bool operator==(const ConstIterator& other) const
+  {
+    return node == other.node;
+  }
+
+  bool operator!=(const ConstIterator& other) const
+  {
+    return !(*this == other);
+  }
+};
+
+}
+
+#endif /* AISDI_MAPS_CONCURRENTSKIPLISTMAP_H */
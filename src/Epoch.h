@@ -0,0 +1,213 @@
+#ifndef AISDI_MAPS_EPOCH_H
+#define AISDI_MAPS_EPOCH_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace aisdi
+{
+
+///odzyskiwanie pamięci epokami (EBR) dla struktur bez blokad. Wątek czyta strukturę tylko pod Guard,
+///który ogłasza bieżącą epokę globalną. Odpięty element trafia do retire() z epoką z chwili odpięcia
+///i jest zwalniany, gdy epoka globalna wyprzedzi ją o 2 - wtedy żaden wątek nie może już go widzieć.
+///Epoka przesuwa się tylko, gdy wszystkie aktywne wątki ogłosiły bieżącą, więc wątek zatrzymany
+///w Guard wstrzymuje zwalnianie, ale nie postęp innych
+class EpochDomain
+{
+public:
+  using Deleter = void (*)(void*);
+
+private:
+  enum : std::uint64_t { Active = 1 };       ///najmłodszy bit ogłoszenia; reszta to epoka
+  enum : unsigned { DomainOwned = 1, ThreadOwned = 2 };
+  enum { CollectEvery = 64 };                ///co tyle retire() próba przesunięcia epoki i sprzątania
+
+  struct Retired
+  {
+    void* pointer;
+    Deleter deleter;
+    std::uint64_t epoch;
+  };
+
+  ///stan jednego wątku w jednej domenie; żyje, dopóki trzyma go domena albo wątek - zwalnia ten, kto puszcza ostatni
+  struct Record
+  {
+    std::atomic<std::uint64_t> announced{0}; ///(epoka << 1) | Active albo 0 poza Guard
+    std::atomic<unsigned> owners{DomainOwned | ThreadOwned};
+    Record* next = nullptr;                  ///lista rekordów domeny, tylko dopisywana
+    unsigned nesting = 0;                    ///zagnieżdżone Guard tego samego wątku
+    std::vector<Retired> retired;
+    char padding[64];                        ///ogłoszenia różnych wątków w różnych liniach pamięci podręcznej
+
+    void releaseByThread()
+    {
+      if(owners.fetch_and(~ThreadOwned, std::memory_order_acq_rel) == ThreadOwned)  delete this;
+    }
+  };
+
+  struct ThreadRecords ///rekordy wątku we wszystkich domenach; oddawane przy końcu wątku
+  {
+    std::vector<std::pair<std::uint64_t, Record*>> entries;
+    std::uint64_t last_id = 0;
+    Record* last = nullptr;
+
+    ~ThreadRecords()
+    {
+      for(auto it = entries.begin(); it != entries.end(); ++it)  it->second->releaseByThread();
+    }
+  };
+
+  std::atomic<std::uint64_t> epoch;
+  std::atomic<Record*> records;
+  const std::uint64_t id; ///niepowtarzalny - adres zniszczonej domeny może dostać nowa
+
+  static std::uint64_t nextId()
+  {
+    static std::atomic<std::uint64_t> counter(0);
+    return counter.fetch_add(1, std::memory_order_relaxed) + 1;
+  }
+
+  static ThreadRecords& threadRecords()
+  {
+    static thread_local ThreadRecords local;
+    return local;
+  }
+
+  Record* record() const
+  {
+    ThreadRecords& local = threadRecords();
+    if(local.last_id == id)  return local.last;
+    for(auto it = local.entries.begin(); it != local.entries.end(); ++it)
+      if(it->first == id) {
+        local.last_id = id;
+        local.last = it->second;
+        return it->second;
+      }
+    return const_cast<EpochDomain*>(this)->attach(local);
+  }
+
+  ///rekord porzucony przez zakończony wątek albo nowy; przy okazji wątek puszcza rekordy zniszczonych domen
+  Record* attach(ThreadRecords& local)
+  {
+    auto dead = std::remove_if(local.entries.begin(), local.entries.end(), [](const std::pair<std::uint64_t, Record*>& entry) {
+      if(entry.second->owners.load(std::memory_order_acquire) & DomainOwned)  return false;
+      entry.second->releaseByThread();
+      return true;
+    });
+    local.entries.erase(dead, local.entries.end());
+
+    Record *found = nullptr;
+    for(Record *it = records.load(std::memory_order_acquire); it != nullptr && found == nullptr; it = it->next) {
+      unsigned expected = DomainOwned;
+      if(it->owners.compare_exchange_strong(expected, DomainOwned | ThreadOwned, std::memory_order_acq_rel))  found = it;
+    }
+    if(found == nullptr) {
+      found = new Record();
+      found->next = records.load(std::memory_order_relaxed);
+      while(!records.compare_exchange_weak(found->next, found, std::memory_order_release, std::memory_order_relaxed)) {}
+    }
+    local.entries.emplace_back(id, found);
+    local.last_id = id;
+    local.last = found;
+    return found;
+  }
+
+  void enter(Record* record) const
+  {
+    if(record->nesting++ == 0)
+      record->announced.store((epoch.load(std::memory_order_seq_cst) << 1) | Active, std::memory_order_seq_cst);
+  }
+
+  static void leave(Record* record)
+  {
+    if(--record->nesting == 0)  record->announced.store(0, std::memory_order_release);
+  }
+
+  bool tryAdvance()
+  {
+    std::uint64_t current = epoch.load(std::memory_order_seq_cst);
+    for(Record *it = records.load(std::memory_order_acquire); it != nullptr; it = it->next) {
+      std::uint64_t announced = it->announced.load(std::memory_order_seq_cst);
+      if((announced & Active) && (announced >> 1) != current)  return false;
+    }
+    return epoch.compare_exchange_strong(current, current + 1, std::memory_order_seq_cst);
+  }
+
+  void collect(Record* record)
+  {
+    tryAdvance();
+    const std::uint64_t safe = epoch.load(std::memory_order_acquire);
+    auto kept = std::partition(record->retired.begin(), record->retired.end(),
+                               [safe](const Retired& item) { return item.epoch + 2 > safe; });
+    for(auto it = kept; it != record->retired.end(); ++it)  it->deleter(it->pointer);
+    record->retired.erase(kept, record->retired.end());
+  }
+
+public:
+  class Guard ///ogłoszona epoka trwa, dopóki istnieje którakolwiek kopia; tylko w wątku, który ją utworzył
+  {
+  public:
+    Guard() : record(nullptr) {}
+
+    explicit Guard(const EpochDomain& domain) : record(domain.record())
+    {
+      domain.enter(record);
+    }
+
+    Guard(const Guard& other) : record(other.record)
+    {
+      if(record != nullptr)  ++record->nesting;
+    }
+
+    Guard& operator=(Guard other)
+    {
+      std::swap(record, other.record);
+      return *this;
+    }
+
+    ~Guard()
+    {
+      if(record != nullptr)  leave(record);
+    }
+
+  private:
+    Record *record;
+  };
+
+  EpochDomain() : epoch(0), records(nullptr), id(nextId()) {}
+
+  EpochDomain(const EpochDomain&) = delete;
+  EpochDomain& operator=(const EpochDomain&) = delete;
+
+  ///żaden wątek nie może już korzystać z domeny; zwalnia wszystko, co czeka, także po zakończonych wątkach
+  ~EpochDomain()
+  {
+    for(Record *it = records.load(std::memory_order_acquire); it != nullptr; ) {
+      Record *next = it->next;
+      for(auto item = it->retired.begin(); item != it->retired.end(); ++item)  item->deleter(item->pointer);
+      it->retired.clear();
+      if(it->owners.fetch_and(~DomainOwned, std::memory_order_acq_rel) == DomainOwned)  delete it;
+      it = next;
+    }
+  }
+
+  void retire(void* pointer, Deleter deleter) ///pointer musi być już nieosiągalny dla nowych czytelników
+  {
+    Record *local = record();
+    local->retired.push_back(Retired{ pointer, deleter, epoch.load(std::memory_order_seq_cst) });
+    if(local->retired.size() % CollectEvery == 0)  collect(local);
+  }
+
+  std::uint64_t current() const
+  {
+    return epoch.load(std::memory_order_relaxed);
+  }
+};
+
+}
+
+#endif /* AISDI_MAPS_EPOCH_H */
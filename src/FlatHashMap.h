@@ -0,0 +1,621 @@
+#ifndef AISDI_MAPS_FLATHASHMAP_H
+#define AISDI_MAPS_FLATHASHMAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+#include "Functional.h"
+
+#if !defined(AISDI_FLATHASHMAP_SCALAR)
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define AISDI_FLATHASHMAP_AVX2
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define AISDI_FLATHASHMAP_SSE2
+#endif
+#endif
+
+namespace aisdi
+{
+
+namespace flat
+{
+
+///bajt kontrolny: 0..127 - zajęte (7 bitów hasha), wartości ujemne - wolne
+using ctrl_t = std::int8_t;
+const ctrl_t kEmpty = -128;
+const ctrl_t kDeleted = -2;
+
+class BitMask ///maska dopasowań w grupie, po jednym bicie (lub bajcie) na slot
+{
+public:
+  BitMask(std::uint64_t mask, unsigned shift) : mask(mask), shift(shift) {}
+
+  explicit operator bool() const
+  {
+    return mask != 0;
+  }
+
+  unsigned lowest() const
+  {
+    return static_cast<unsigned>(__builtin_ctzll(mask)) >> shift;
+  }
+
+  void clearLowest()
+  {
+    mask &= mask - 1;
+  }
+
+private:
+  std::uint64_t mask;
+  unsigned shift;
+};
+
+#if defined(AISDI_FLATHASHMAP_AVX2)
+
+struct Group
+{
+  static const std::size_t width = 32;
+  __m256i ctrl;
+
+  explicit Group(const ctrl_t* pos) : ctrl(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pos))) {}
+
+  BitMask match(ctrl_t h2) const
+  {
+    return BitMask(static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_set1_epi8(h2), ctrl))), 0);
+  }
+
+  BitMask matchEmpty() const
+  {
+    return match(kEmpty);
+  }
+
+  BitMask matchFree() const ///puste lub usunięte - bit znaku ustawiony
+  {
+    return BitMask(static_cast<std::uint32_t>(_mm256_movemask_epi8(ctrl)), 0);
+  }
+};
+
+#elif defined(AISDI_FLATHASHMAP_SSE2)
+
+struct Group
+{
+  static const std::size_t width = 16;
+  __m128i ctrl;
+
+  explicit Group(const ctrl_t* pos) : ctrl(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pos))) {}
+
+  BitMask match(ctrl_t h2) const
+  {
+    return BitMask(static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl))), 0);
+  }
+
+  BitMask matchEmpty() const
+  {
+    return match(kEmpty);
+  }
+
+  BitMask matchFree() const ///puste lub usunięte - bit znaku ustawiony
+  {
+    return BitMask(static_cast<std::uint32_t>(_mm_movemask_epi8(ctrl)), 0);
+  }
+};
+
+#else
+
+struct Group ///wersja skalarna - 8 bajtów naraz w jednym słowie (SWAR)
+{
+  static const std::size_t width = 8;
+  static const std::uint64_t lsbs = 0x0101010101010101ull;
+  static const std::uint64_t msbs = 0x8080808080808080ull;
+  std::uint64_t ctrl;
+
+  explicit Group(const ctrl_t* pos)
+  {
+    std::memcpy(&ctrl, pos, sizeof(ctrl));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    ctrl = __builtin_bswap64(ctrl);
+#endif
+  }
+
+  BitMask match(ctrl_t h2) const ///może dać fałszywe trafienia, klucz i tak jest porównywany
+  {
+    std::uint64_t x = ctrl ^ (lsbs * static_cast<std::uint8_t>(h2));
+    return BitMask((x - lsbs) & ~x & msbs, 3);
+  }
+
+  BitMask matchEmpty() const ///0x80 - najstarszy bit ustawiony, bit 1 wyzerowany
+  {
+    return BitMask(ctrl & ~(ctrl << 6) & msbs, 3);
+  }
+
+  BitMask matchFree() const
+  {
+    return BitMask(ctrl & msbs, 3);
+  }
+};
+
+#endif
+
+}
+
+template <typename KeyType, typename ValueType>
+class FlatHashMap
+{
+public:
+  using key_type = KeyType;
+  using mapped_type = ValueType;
+  using value_type = std::pair<const key_type, mapped_type>;
+  using size_type = std::size_t;
+  using reference = value_type&;
+  using const_reference = const value_type&;
+
+  class ConstIterator;
+  class Iterator;
+  using iterator = Iterator;
+  using const_iterator = ConstIterator;
+
+protected:
+  using ctrl_t = flat::ctrl_t;
+  using Group = flat::Group;
+
+  ctrl_t *ctrl;       ///capacity + Group::width bajtów, początek powielony na końcu
+  value_type *slots;  ///wartości trzymane bezpośrednio w tablicy
+  size_type size;
+  size_type capacity; ///potęga dwójki
+  size_type growth_left;
+
+  ///metody pomocnicze
+
+  static size_type hashOf(const key_type& key)
+  {
+    return Hash<key_type>()(key);
+  }
+
+  static ctrl_t h2(size_type hash)
+  {
+    return static_cast<ctrl_t>(hash & 0x7F);
+  }
+
+  static size_type maxLoad(size_type capacity) ///7/8 zapełnienia
+  {
+    return capacity - capacity / 8;
+  }
+
+  bool isFull(size_type index) const
+  {
+    return ctrl[index] >= 0;
+  }
+
+  void setCtrl(size_type index, ctrl_t value)
+  {
+    ctrl[index] = value;
+    if(index < Group::width)  ctrl[capacity + index] = value;
+  }
+
+  void allocate(size_type buckets)
+  {
+    capacity = buckets;
+    ctrl = new ctrl_t[capacity + Group::width];
+    std::memset(ctrl, static_cast<unsigned char>(flat::kEmpty), capacity + Group::width);
+    slots = std::allocator<value_type>().allocate(capacity);
+    growth_left = maxLoad(capacity);
+  }
+
+  void release()
+  {
+    if(ctrl == nullptr) return;
+    for(size_type i = 0; i < capacity; ++i)
+      if(isFull(i)) slots[i].~value_type();
+    std::allocator<value_type>().deallocate(slots, capacity);
+    delete[] ctrl;
+    ctrl = nullptr;
+    slots = nullptr;
+  }
+
+  void erase()
+  {
+    for(size_type i = 0; i < capacity; ++i)
+      if(isFull(i)) slots[i].~value_type();
+    std::memset(ctrl, static_cast<unsigned char>(flat::kEmpty), capacity + Group::width);
+    size = 0;
+    growth_left = maxLoad(capacity);
+  }
+
+  size_type getIndex(const key_type& key) const ///zwraca capacity gdy brak klucza
+  {
+    size_type hash = hashOf(key);
+    size_type mask = capacity - 1;
+    size_type pos = (hash >> 7) & mask;
+    for(size_type step = Group::width; ; step += Group::width) {
+      Group group(ctrl + pos);
+      for(auto match = group.match(h2(hash)); match; match.clearLowest()) {
+        size_type index = (pos + match.lowest()) & mask;
+        if(slots[index].first == key) return index;
+      }
+      if(group.matchEmpty())  return capacity;
+      pos = (pos + step) & mask;
+    }
+  }
+
+  size_type findFree(size_type hash) const ///pierwszy pusty lub usunięty slot na ścieżce sondowania
+  {
+    size_type mask = capacity - 1;
+    size_type pos = (hash >> 7) & mask;
+    for(size_type step = Group::width; ; step += Group::width) {
+      auto match = Group(ctrl + pos).matchFree();
+      if(match) return (pos + match.lowest()) & mask;
+      pos = (pos + step) & mask;
+    }
+  }
+
+  void resize(size_type buckets)
+  {
+    ctrl_t *old_ctrl = ctrl;
+    value_type *old_slots = slots;
+    size_type old_capacity = capacity;
+
+    allocate(buckets);
+    for(size_type i = 0; i < old_capacity; ++i) {
+      if(old_ctrl[i] < 0) continue;
+      size_type hash = hashOf(old_slots[i].first);
+      size_type index = findFree(hash);
+      setCtrl(index, h2(hash));
+      new (slots + index) value_type(std::move(old_slots[i]));
+      old_slots[i].~value_type();
+    }
+    growth_left -= size;
+
+    std::allocator<value_type>().deallocate(old_slots, old_capacity);
+    delete[] old_ctrl;
+  }
+
+  void prepareInsert()
+  {
+    if(growth_left > 0) return;
+    if(size < maxLoad(capacity) / 2)  resize(capacity); ///dużo usuniętych - wystarczy przebudować
+    else  resize(2 * capacity);
+  }
+
+  void removeAt(size_type index)
+  {
+    slots[index].~value_type();
+    setCtrl(index, flat::kDeleted);
+    --size;
+  }
+
+  size_type getFirst(size_type index) const
+  {
+    while(index < capacity && !isFull(index))
+      ++index;
+    return index;
+  }
+
+public:
+  FlatHashMap() : FlatHashMap(2 * Group::width) {}
+
+  explicit FlatHashMap(size_type buckets) : ctrl(nullptr), slots(nullptr), size(0), capacity(0), growth_left(0)
+  {
+    size_type real = 2 * Group::width;
+    while(maxLoad(real) < buckets) real *= 2;
+    allocate(real);
+  }
+
+  FlatHashMap(std::initializer_list<value_type> list) : FlatHashMap(list.size())
+  {
+    for (auto it = list.begin(); it != list.end(); ++it)
+      operator[]((*it).first) = (*it).second;
+  }
+
+  FlatHashMap(const FlatHashMap& other) : FlatHashMap() ///konstruktor kopiujący
+  {
+    *this = other;
+  }
+
+  FlatHashMap(FlatHashMap&& other) : FlatHashMap()  ///konstruktor przenoszący
+  {
+    *this = std::move(other);
+  }
+
+  ~FlatHashMap()
+  {
+    release();
+  }
+
+  FlatHashMap& operator=(const FlatHashMap& other) ///kopiujemy układ tablicy bez ponownego haszowania
+  {
+    if(this != &other) {
+      release();
+      allocate(other.capacity);
+      std::memcpy(ctrl, other.ctrl, capacity + Group::width);
+      for(size_type i = 0; i < capacity; ++i)
+        if(isFull(i)) new (slots + i) value_type(other.slots[i]);
+      size = other.size;
+      growth_left = other.growth_left;
+    }
+    return *this;
+  }
+
+  FlatHashMap& operator=(FlatHashMap&& other) ///przenoszący operator przypisania
+  {
+    if(this != &other) {
+      erase();
+      std::swap(ctrl, other.ctrl);
+      std::swap(slots, other.slots);
+      std::swap(size, other.size);
+      std::swap(capacity, other.capacity);
+      std::swap(growth_left, other.growth_left);
+    }
+    return *this;
+  }
+
+  bool isEmpty() const
+  {
+    return !size;
+  }
+
+  mapped_type& operator[](const key_type& key)
+  {
+    size_type index = getIndex(key);
+    if(index != capacity) return slots[index].second;
+
+    prepareInsert();
+    size_type hash = hashOf(key);
+    index = findFree(hash);
+    if(ctrl[index] == flat::kEmpty) --growth_left;
+    new (slots + index) value_type(key, mapped_type());
+    setCtrl(index, h2(hash));
+    ++size;
+    return slots[index].second;
+  }
+
+  const mapped_type& valueOf(const key_type& key) const
+  {
+    size_type index = getIndex(key);
+    if(index == capacity)
+      throw std::out_of_range("ValueOf is out of range.");
+    return slots[index].second;
+  }
+
+  mapped_type& valueOf(const key_type& key)
+  {
+    size_type index = getIndex(key);
+    if(index == capacity)
+      throw std::out_of_range("ValueOf is out of range.");
+    return slots[index].second;
+  }
+
+  const_iterator find(const key_type& key) const
+  {
+    return const_iterator(this, getIndex(key));
+  }
+
+  iterator find(const key_type& key)
+  {
+    return iterator(this, getIndex(key));
+  }
+
+  void remove(const key_type& key)
+  {
+    remove(find(key));
+  }
+
+  void remove(const const_iterator& it)
+  {
+    if(this != it.mappu || it == end())
+      throw std::out_of_range("Remove is out of range.");
+    removeAt(it.index);
+  }
+
+  size_type getSize() const
+  {
+    return size;
+  }
+
+  size_type bucket_count() const
+  {
+    return capacity;
+  }
+
+  float load_factor() const
+  {
+    return static_cast<float>(size) / capacity;
+  }
+
+  void reserve(size_type count)
+  {
+    size_type real = capacity;
+    while(maxLoad(real) < count) real *= 2;
+    if(real != capacity)  resize(real);
+  }
+
+  bool operator==(const FlatHashMap& other) const
+  {
+    if(size != other.size)  return false;
+    for(auto it = begin(); it != end(); ++it) {
+      size_type index = other.getIndex(it->first);
+      if(index == other.capacity || other.slots[index].second != it->second) return false;
+    }
+    return true;
+  }
+
+  bool operator!=(const FlatHashMap& other) const
+  {
+    return !(*this == other);
+  }
+
+  iterator begin()
+  {
+    return iterator(this, getFirst(0));
+  }
+
+  iterator end()
+  {
+    return iterator(this, capacity);
+  }
+
+  const_iterator cbegin() const
+  {
+    return const_iterator(this, getFirst(0));
+  }
+
+  const_iterator cend() const
+  {
+    return const_iterator(this, capacity);
+  }
+
+  const_iterator begin() const
+  {
+    return cbegin();
+  }
+
+  const_iterator end() const
+  {
+    return cend();
+  }
+};
+
+template <typename KeyType, typename ValueType>
+class FlatHashMap<KeyType, ValueType>::ConstIterator
+{
+public:
+  using reference = typename FlatHashMap::const_reference;
+  using iterator_category = std::bidirectional_iterator_tag;
+  using value_type = typename FlatHashMap::value_type;
+  using pointer = const typename FlatHashMap::value_type*;
+
+protected:
+  const FlatHashMap *mappu;
+  size_type index;
+  friend void FlatHashMap<KeyType, ValueType>::remove(const const_iterator&);
+
+public:
+  explicit ConstIterator(const FlatHashMap *mappu = nullptr, size_type index = 0)
+  : mappu(mappu), index(index)
+  {}
+
+  ConstIterator(const ConstIterator& other)
+  : ConstIterator(other.mappu, other.index)
+  {}
+
+  ConstIterator& operator++()
+  {
+    if(mappu == nullptr || index >= mappu->capacity)  throw std::out_of_range("Operator++ is out of range.");
+    index = mappu->getFirst(index + 1);
+    return *this;
+  }
+
+  ConstIterator operator++(int)
+  {
+    auto result = *this;
+    ConstIterator::operator++();
+    return result;
+  }
+
+  ConstIterator& operator--()
+  {
+    if(mappu == nullptr)  throw std::out_of_range("Operator-- is out of range.");
+    size_type prev = index;
+    while(prev > 0) {
+      --prev;
+      if(mappu->isFull(prev)) {
+        index = prev;
+        return *this;
+      }
+    }
+    throw std::out_of_range("Operator-- is out of range.");
+  }
+
+  ConstIterator operator--(int)
+  {
+    auto result = *this;
+    ConstIterator::operator--();
+    return result;
+  }
+
+  reference operator*() const
+  {
+    if(mappu == nullptr || index >= mappu->capacity)  throw std::out_of_range("Operator* is out of range.");
+    return mappu->slots[index];
+  }
+
+  pointer operator->() const
+  {
+    return &this->operator*();
+  }
+
+  bool operator==(const ConstIterator& other) const
+  {
+    return mappu == other.mappu && index == other.index;
+  }
+
+  bool operator!=(const ConstIterator& other) const
+  {
+    return !(*this == other);
+  }
+};
+
+template <typename KeyType, typename ValueType>
+class FlatHashMap<KeyType, ValueType>::Iterator : public FlatHashMap<KeyType, ValueType>::ConstIterator
+{
+public:
+  using reference = typename FlatHashMap::reference;
+  using pointer = typename FlatHashMap::value_type*;
+
+  explicit Iterator(FlatHashMap *mappu = nullptr, size_type index = 0)
+  : ConstIterator(mappu, index)
+  {}
+
+  Iterator(const ConstIterator& other)
+    : ConstIterator(other)
+  {}
+
+  Iterator& operator++()
+  {
+    ConstIterator::operator++();
+    return *this;
+  }
+
+  Iterator operator++(int)
+  {
+    auto result = *this;
+    ConstIterator::operator++();
+    return result;
+  }
+
+  Iterator& operator--()
+  {
+    ConstIterator::operator--();
+    return *this;
+  }
+
+  Iterator operator--(int)
+  {
+    auto result = *this;
+    ConstIterator::operator--();
+    return result;
+  }
+
+  pointer operator->() const
+  {
+    return &this->operator*();
+  }
+
+  reference operator*() const
+  {
+    // ugly cast, yet reduces code duplication.
+    return const_cast<reference>(ConstIterator::operator*());
+  }
+};
+
+}
+
+#endif /* AISDI_MAPS_FLATHASHMAP_H */
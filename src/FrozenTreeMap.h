@@ -0,0 +1,350 @@
+#ifndef AISDI_MAPS_FROZENTREEMAP_H
+#define AISDI_MAPS_FROZENTREEMAP_H
+
+#include <cstddef>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Functional.h"
+
+namespace aisdi
+{
+
+///niezmienna mapa uporządkowana: klucze w układzie Eytzingera (kopiec w kolejności BFS - dzieci węzła i
+///to 2i i 2i+1), wartości w osobnej tablicy pod tymi samymi indeksami. Zejście bez rozgałęzień: w pętli jest
+///tylko i = 2i + (klucz < szukany), a pierwsze poziomy leżą obok siebie w pamięci podręcznej.
+///Powstaje z TreeMap::freeze() albo z posortowanego zakresu par; iteratory tylko stałe, w kolejności kluczy
+template <typename KeyType, typename ValueType, typename Compare = Less>
+class FrozenTreeMap
+{
+public:
+  using key_type = KeyType;
+  using mapped_type = ValueType;
+  using value_type = std::pair<const key_type, mapped_type>;
+  using size_type = std::size_t;
+  using key_compare = Compare;
+  using reference = std::pair<const key_type&, const mapped_type&>; ///klucz i wartość leżą osobno
+  using const_reference = reference;
+
+  class ConstIterator;
+  using const_iterator = ConstIterator;
+  using iterator = ConstIterator;
+
+private:
+  std::vector<key_type> keys;      ///keys[i - 1] to węzeł i; indeks 0 oznacza koniec
+  std::vector<mapped_type> values;
+  key_compare compare;
+
+  template <typename K>
+  using EnableLookup = typename std::enable_if<IsTransparent<key_compare>::value
+                                               && !std::is_convertible<const K&, const_iterator>::value>::type;
+
+  enum { FitKeys = 64 / sizeof(key_type) };  ///kluczy w jednej linii pamięci
+  ///potęga dwójki nie większa niż FitKeys: tylko wtedy index * LineKeys jest potomkiem index (o log2 poziomów niżej)
+  enum { LineKeys = FitKeys >= 64 ? 64 : FitKeys >= 32 ? 32 : FitKeys >= 16 ? 16 : FitKeys >= 8 ? 8
+                    : FitKeys >= 4 ? 4 : FitKeys >= 2 ? 2 : 1 };
+
+  ///wyszukiwanie przesuwa się w dół o jeden poziom na krok, więc prefetch potomków o log2(LineKeys) poziomów
+  ///niżej zdąży przed tym, jak będą potrzebne. Jest ich LineKeys i są sąsiadami w tablicy, ale keys nie jest
+  ///wyrównane do 64 bajtów, więc grupa zwykle zahacza o dwie linie - pobierana jest tylko ta z jej początkiem
+  ///(prefetch obu linii nie dał mierzalnej różnicy)
+  void prefetchBelow(size_type index) const
+  {
+    size_type below = index * LineKeys;
+    if(LineKeys > 1 && below <= keys.size())  prefetch(keys.data() + below - 1); ///klucz większy niż linia - nie ma czego uprzedzać
+  }
+
+  ///liczby: zejście bez skoków - wynik porównania od razu staje się indeksem. Klucze z danymi na stercie
+  ///(np. std::string): skok warunkowy, bo procesor schodzi spekulatywnie dalej i nakłada chybienia na siebie,
+  ///zamiast czekać na każde porównanie
+  static size_type descend(size_type index, bool right)
+  {
+    if(std::is_arithmetic<key_type>::value)  return 2 * index + static_cast<size_type>(right);
+    if(right)  return 2 * index + 1;
+    return 2 * index;
+  }
+
+  static size_type cancelRightTurns(size_type index) ///cofa zejścia w prawo i ostatni krok w lewo
+  {
+#if defined(__GNUC__)
+    return index >> __builtin_ffsll(static_cast<long long>(~index));
+#else
+    while(index & 1)  index >>= 1;
+    return index >> 1;
+#endif
+  }
+
+  template <typename K>
+  size_type lowerIndex(const K& key) const ///pierwszy węzeł z kluczem >= key, 0 gdy brak
+  {
+    const size_type n = keys.size();
+    size_type index = 1;
+    while(index <= n) {
+      prefetchBelow(index);
+      index = descend(index, compare(keys[index - 1], key));
+    }
+    return cancelRightTurns(index);
+  }
+
+  template <typename K>
+  size_type upperIndex(const K& key) const ///pierwszy węzeł z kluczem > key, 0 gdy brak
+  {
+    const size_type n = keys.size();
+    size_type index = 1;
+    while(index <= n) {
+      prefetchBelow(index);
+      index = descend(index, !compare(key, keys[index - 1]));
+    }
+    return cancelRightTurns(index);
+  }
+
+  template <typename K>
+  size_type findIndex(const K& key) const
+  {
+    size_type index = lowerIndex(key);
+    return index != 0 && !compare(key, keys[index - 1]) ? index : 0;
+  }
+
+  size_type firstIndex() const
+  {
+    if(keys.empty())  return 0;
+    size_type index = 1;
+    while(2 * index <= keys.size())  index *= 2;
+    return index;
+  }
+
+  size_type lastIndex() const
+  {
+    if(keys.empty())  return 0;
+    size_type index = 1;
+    while(2 * index + 1 <= keys.size())  index = 2 * index + 1;
+    return index;
+  }
+
+  ///in-order po drzewie niejawnym: layout[i] dostaje kolejny element posortowanego ciągu
+  template <typename It>
+  static void placeInOrder(std::vector<It>& layout, It& it, size_type index)
+  {
+    if(index >= layout.size())  return;
+    placeInOrder(layout, it, 2 * index);
+    layout[index] = it++;
+    placeInOrder(layout, it, 2 * index + 1);
+  }
+
+  template <typename It>
+  void assignSorted(It first, size_type count)
+  {
+    if(count == 0)  return;
+    std::vector<It> layout(count + 1, first);
+    placeInOrder(layout, first, 1);
+    keys.reserve(count);
+    values.reserve(count);
+    for(size_type i = 1; i <= count; ++i) {
+      keys.push_back(layout[i]->first);
+      values.push_back(layout[i]->second);
+    }
+  }
+
+public:
+  FrozenTreeMap() = default;
+
+  ///z posortowanego zakresu par o różnych kluczach, np. iteratorów TreeMap; inaczej std::invalid_argument
+  template <typename It, typename = typename std::iterator_traits<It>::iterator_category>
+  FrozenTreeMap(It first, It last, const Compare& compare = Compare())
+    : compare(compare)
+  {
+    size_type count = 0;
+    for(It it = first, prev = first; it != last; prev = it, ++it, ++count)
+      if(count > 0 && !compare(prev->first, it->first))
+        throw std::invalid_argument("Input is not sorted or has duplicate keys.");
+    assignSorted(first, count);
+  }
+
+  size_type getSize() const
+  {
+    return keys.size();
+  }
+
+  bool isEmpty() const
+  {
+    return keys.empty();
+  }
+
+  key_compare key_comp() const
+  {
+    return compare;
+  }
+
+  const mapped_type& valueOf(const key_type& key) const
+  {
+    size_type index = findIndex(key);
+    if(index == 0)  throw std::out_of_range("ValueOf is out of range.");
+    return values[index - 1];
+  }
+
+  const_iterator find(const key_type& key) const
+  {
+    return const_iterator(this, findIndex(key));
+  }
+
+  const_iterator lower_bound(const key_type& key) const
+  {
+    return const_iterator(this, lowerIndex(key));
+  }
+
+  const_iterator upper_bound(const key_type& key) const
+  {
+    return const_iterator(this, upperIndex(key));
+  }
+
+  template <typename K, typename = EnableLookup<K>>
+  const mapped_type& valueOf(const K& key) const
+  {
+    size_type index = findIndex(key);
+    if(index == 0)  throw std::out_of_range("ValueOf is out of range.");
+    return values[index - 1];
+  }
+
+  template <typename K, typename = EnableLookup<K>>
+  const_iterator find(const K& key) const
+  {
+    return const_iterator(this, findIndex(key));
+  }
+
+  template <typename K, typename = EnableLookup<K>>
+  const_iterator lower_bound(const K& key) const
+  {
+    return const_iterator(this, lowerIndex(key));
+  }
+
+  template <typename K, typename = EnableLookup<K>>
+  const_iterator upper_bound(const K& key) const
+  {
+    return const_iterator(this, upperIndex(key));
+  }
+
+  std::size_t bytes() const ///klucze i wartości bez wskaźników; bez pamięci przydzielanej przez nie same
+  {
+    return sizeof(*this) + keys.capacity() * sizeof(key_type) + values.capacity() * sizeof(mapped_type);
+  }
+
+  const_iterator cbegin() const
+  {
+    return const_iterator(this, firstIndex());
+  }
+
+  const_iterator cend() const
+  {
+    return const_iterator(this, 0);
+  }
+
+  const_iterator begin() const
+  {
+    return cbegin();
+  }
+
+  const_iterator end() const
+  {
+    return cend();
+  }
+};
+
+template <typename KeyType, typename ValueType, typename Compare>
+class FrozenTreeMap<KeyType, ValueType, Compare>::ConstIterator
+{
+public:
+  using reference = typename FrozenTreeMap::reference;
+  using iterator_category = std::bidirectional_iterator_tag;
+  using value_type = typename FrozenTreeMap::value_type;
+  using difference_type = std::ptrdiff_t;
+
+  struct pointer ///operator-> musi zwrócić coś, co trzyma parę referencji
+  {
+    reference value;
+    const reference* operator->() const { return &value; }
+  };
+
+private:
+  const FrozenTreeMap *map;
+  size_type index; ///numer węzła w układzie Eytzingera, 0 - koniec
+
+public:
+  explicit ConstIterator(const FrozenTreeMap *map = nullptr, size_type index = 0)
+  : map(map), index(index) {}
+
+  ConstIterator& operator++() ///następnik: skrajnie lewy w prawym poddrzewie albo przodek, do którego wracamy z lewej
+  {
+    if(map == nullptr || index == 0)  throw std::out_of_range("Operator++ is out of range.");
+    if(2 * index + 1 <= map->keys.size()) {
+      index = 2 * index + 1;
+      while(2 * index <= map->keys.size())  index *= 2;
+    }
+    else {
+      while(index & 1)  index >>= 1;
+      index >>= 1;
+    }
+    return *this;
+  }
+
+  ConstIterator operator++(int)
+  {
+    auto result = *this;
+    operator++();
+    return result;
+  }
+
+  ConstIterator& operator--()
+  {
+    if(map == nullptr)  throw std::out_of_range("Operator-- is out of range.");
+    if(index == 0) {
+      if(map->keys.empty())  throw std::out_of_range("Operator-- is out of range.");
+      index = map->lastIndex();
+    }
+    else if(2 * index <= map->keys.size()) {
+      index = 2 * index;
+      while(2 * index + 1 <= map->keys.size())  index = 2 * index + 1;
+    }
+    else {
+      size_type up = index;
+      while(!(up & 1))  up >>= 1;
+      if(up == 1)  throw std::out_of_range("Operator-- is out of range.");
+      index = up >> 1;
+    }
+    return *this;
+  }
+
+  ConstIterator operator--(int)
+  {
+    auto result = *this;
+    operator--();
+    return result;
+  }
+
+  reference operator*() const
+  {
+    if(map == nullptr || index == 0)  throw std::out_of_range("Operator* is out of range.");
+    return reference(map->keys[index - 1], map->values[index - 1]);
+  }
+
+  pointer operator->() const
+  {
+    return pointer{ operator*() };
+  }
+
+  bool operator==(const ConstIterator& other) const
+  {
+    return map == other.map && index == other.index;
+  }
+
+  bool operator!=(const ConstIterator& other) const
+  {
+    return !(*this == other);
+  }
+};
+
+}
+
+#endif /* AISDI_MAPS_FROZENTREEMAP_H */
@@ -0,0 +1,100 @@
+#ifndef AISDI_MAPS_FUNCTIONAL_H
+#define AISDI_MAPS_FUNCTIONAL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+
+namespace aisdi
+{
+
+template <typename...>
+using VoidT = void;
+
+template <typename T, typename = void>
+struct IsTransparent : std::false_type {};
+
+template <typename T>
+struct IsTransparent<T, VoidT<typename T::is_transparent>> : std::true_type {};
+
+struct Less ///porównuje dowolne typy, które mają operator< z kluczem
+{
+  using is_transparent = void;
+
+  template <typename T, typename U>
+  bool operator()(const T& lhs, const U& rhs) const
+  {
+    return lhs < rhs;
+  }
+};
+
+struct EqualTo
+{
+  using is_transparent = void;
+
+  template <typename T, typename U>
+  bool operator()(const T& lhs, const U& rhs) const
+  {
+    return lhs == rhs;
+  }
+};
+
+constexpr std::uint64_t mix(std::uint64_t hash) ///finalizer z MurmurHash3 - każdy bit wejścia wpływa na każdy bit wyniku
+{
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdull;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ull;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+constexpr std::size_t fibonacciReduce(std::uint64_t hash, unsigned shift) ///mnożenie przez 2^64/φ zamiast modulo
+{
+  return static_cast<std::size_t>((hash * 11400714819323198485ull) >> shift);
+}
+
+inline void prefetch(const void* address) ///podpowiedź dla procesora: linia będzie wkrótce czytana
+{
+#if defined(__GNUC__)
+  __builtin_prefetch(address, 0, 3);
+#else
+  (void)address;
+#endif
+}
+
+template <typename Key>
+struct Hash ///std::hash<int> to identyczność, dlatego wynik jest dodatkowo mieszany
+{
+  std::size_t operator()(const Key& key) const
+  {
+    return static_cast<std::size_t>(mix(std::hash<Key>()(key)));
+  }
+};
+
+#if __cplusplus >= 201703L
+///std::hash<std::string> i std::hash<std::string_view> dają ten sam wynik dla tych samych znaków,
+///więc string_view, const char* i literały można haszować bez tworzenia std::string
+template <typename CharT, typename Traits, typename Allocator>
+struct Hash<std::basic_string<CharT, Traits, Allocator>>
+{
+  using is_transparent = void;
+
+  template <typename T>
+  std::size_t operator()(const T& value) const
+  {
+    return std::hash<std::basic_string_view<CharT, Traits>>()(std::basic_string_view<CharT, Traits>(value));
+  }
+};
+#endif
+
+}
+
+#endif /* AISDI_MAPS_FUNCTIONAL_H */
@@ -1,17 +1,31 @@
 #ifndef AISDI_MAPS_HASHMAP_H
 #define AISDI_MAPS_HASHMAP_H
 
+#include <algorithm>
+#include <cmath>
 #include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <new>
 #include <initializer_list>
+#include <memory>
+#include <tuple>
 #include <stdexcept>
+#include <type_traits>
 #include <utility>
 
 #include <iostream>
 
+#include "Functional.h"
+#include "NodePool.h"
+#include "Stats.h"
+
 namespace aisdi
 {
 
-template <typename KeyType, typename ValueType>
+template <typename KeyType, typename ValueType,
+          typename Hash = aisdi::Hash<KeyType>, typename KeyEqual = EqualTo,
+          typename Allocator = std::allocator<std::pair<const KeyType, ValueType>>>
 class HashMap
 {
 public:
@@ -21,6 +35,9 @@ public:
   using size_type = std::size_t;
   using reference = value_type&;
   using const_reference = const value_type&;
+  using allocator_type = Allocator;
+  using hasher = Hash;
+  using key_equal = KeyEqual;
 
   class ConstIterator;
   class Iterator;
@@ -31,71 +48,324 @@ protected:
   struct HashNode
   {
     value_type value;
-    HashNode *next;
-    HashNode *prev;
-    HashNode(key_type key, mapped_type mapped) : value(std::make_pair(key, mapped)), next(nullptr), prev(nullptr) {}
-    HashNode(key_type key, mapped_type mapped, HashNode *prev) : HashNode(key, mapped) { this->prev = prev; }
-    HashNode(key_type key, mapped_type mapped, HashNode *next, HashNode *prev) : HashNode(key, mapped) { this->next = next, this->prev = prev; }
-    ~HashNode() { delete next; }
+    HashNode *next;              ///następny w łańcuchu kubełka
+    HashNode *before, *after;    ///sąsiedzi w kolejności wstawiania - po nich chodzą iteratory
+    std::size_t hashed;          ///zapamiętany skrót: przenoszenie i kopiowanie bez ponownego haszowania
+    template <typename... Args>
+    explicit HashNode(Args&&... args) ///wartość budowana w miejscu
+      : value(std::forward<Args>(args)...), next(nullptr), before(nullptr), after(nullptr), hashed(0) {}
   };
+  using NodeAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<HashNode>;
+  using NodeTraits = std::allocator_traits<NodeAllocator>;
+
   HashNode **table;
+  HashNode *head, *tail;  ///najstarszy i najmłodszy węzeł
   size_type size;
-  size_type real_size;
+  size_type real_size; ///zawsze potęga dwójki
+  unsigned shift;      ///64 - log2(real_size)
+  float max_load;
+  HashNode **old_table;   ///w trakcie migracji tablica sprzed powiększenia, poza nią nullptr
+  size_type old_size;
+  unsigned old_shift;
+  size_type migrated;     ///kubełki old_table[0, migrated) są już przeniesione i puste
+  size_type step;         ///kubełków przenoszonych przy każdej zmianie mapy; 0 - rehash od razu w całości
+  NodeAllocator alloc;
+  hasher hash;
+  key_equal equal;
+#ifdef AISDI_MAPS_COUNTERS
+  mutable AtomicCounters counters;
+#endif
+
+  template <typename K> ///wyszukiwanie po typie haszowalnym jak klucz, bez tworzenia key_type
+  using EnableLookup = typename std::enable_if<IsTransparent<hasher>::value && IsTransparent<key_equal>::value
+                                               && !std::is_convertible<const K&, const_iterator>::value>::type;
 
   ///metody pomocnicze
 
-  size_type hashFunction(const key_type& key) const
+  ///calloc dużego bloku dostaje od systemu wyzerowane strony bez memset - koszt zerowania
+  ///rozkłada się na pierwsze dostępy zamiast obciążać operację, która powiększa tablicę
+  static HashNode** newTable(size_type buckets)
+  {
+    void* memory = std::calloc(buckets, sizeof(HashNode*));
+    if(memory == nullptr)  throw std::bad_alloc();
+    return static_cast<HashNode**>(memory);
+  }
+
+  static void deleteTable(HashNode** buckets)
+  {
+    std::free(buckets);
+  }
+
+  static size_type roundBuckets(size_type buckets)
+  {
+    size_type result = 2;
+    while(result < buckets) result *= 2;
+    return result;
+  }
+
+  static unsigned shiftFor(size_type buckets)
   {
-    return std::hash<key_type>()(key) % real_size;
+    unsigned bits = 0;
+    while((size_type(1) << bits) < buckets) ++bits;
+    return 64 - bits;
   }
 
-  void erase()
+  template <typename... Args>
+  HashNode* createNode(Args&&... args)
+  {
+    HashNode* node = NodeTraits::allocate(alloc, 1);
+    try {
+      NodeTraits::construct(alloc, node, std::forward<Args>(args)...);
+    }
+    catch(...) {
+      NodeTraits::deallocate(alloc, node, 1);
+      throw;
+    }
+    AISDI_MAPS_COUNT(allocations);
+    return node;
+  }
+
+  void destroyNode(HashNode* node)
+  {
+    AISDI_MAPS_COUNT(deallocations);
+    NodeTraits::destroy(alloc, node);
+    NodeTraits::deallocate(alloc, node, 1);
+  }
+
+  void erase() ///węzły po liście kolejności, tablica zerowana w całości
   {
     if(size) {
-      for(size_type i = 0; i < real_size; ++i) {
-        delete table[i];
-        table[i] = nullptr;
-      }
+      bool drop = ArenaTraits<NodeAllocator>::exclusive(alloc); ///cała arena należy do nas - zwalniamy ją w całości
+      if(drop)  AISDI_MAPS_COUNT_N(deallocations, size);
+      if(!drop || !std::is_trivially_destructible<value_type>::value)
+        for(HashNode *node = head; node != nullptr; ) {
+          HashNode *next = node->after;
+          if(drop)  NodeTraits::destroy(alloc, node);
+          else  destroyNode(node);
+          node = next;
+        }
+      std::memset(static_cast<void*>(table), 0, real_size * sizeof(HashNode*));
+      if(drop)  ArenaTraits<NodeAllocator>::release(alloc);
     }
+    head = tail = nullptr;
     size = 0;
+    endMigration();
+  }
+
+  void relink(HashNode* node) ///do table, na początek łańcucha
+  {
+    HashNode *&bucket = table[fibonacciReduce(node->hashed, shift)];
+    node->next = bucket;
+    bucket = node;
+  }
+
+  void endMigration()
+  {
+    deleteTable(old_table);
+    old_table = nullptr;
+    old_size = 0;
+    migrated = 0;
   }
 
-  void remove(HashNode* node, const key_type& key)
+  void migrate(size_type buckets) ///przenosi kolejne buckets kubełków starej tablicy
   {
-    if(node->prev == nullptr) table[hashFunction(key)] = node->next;
-    else  node->prev->next = node->next;
+    if(old_table == nullptr)  return;
+    size_type stop = old_size - migrated < buckets ? old_size : migrated + buckets;
+    for(; migrated < stop; ++migrated) {
+      HashNode *node = old_table[migrated];
+      old_table[migrated] = nullptr;
+      while(node != nullptr) {
+        HashNode *next = node->next;
+        relink(node);
+        node = next;
+      }
+    }
+    if(migrated == old_size)  endMigration();
+  }
 
-    if(node->next != nullptr) node->next->prev = node->prev;
+  void startMigration(size_type buckets) ///nowa tablica od razu przyjmuje wstawienia, stara opróżniana po kawałku
+  {
+    migrate(old_size); ///poprzednia migracja musi się skończyć - zdarza się tylko przy bardzo małym max_load
+    HashNode **fresh = newTable(buckets);
+    AISDI_MAPS_COUNT(rehashes);
+    old_table = table;
+    old_size = real_size;
+    old_shift = shift;
+    migrated = 0;
+    table = fresh;
+    real_size = buckets;
+    shift = shiftFor(buckets);
+  }
 
-    node->next = nullptr;
-    delete node;
+  void link(HashNode* node) ///node->hashed już ustawiony; na początek łańcucha i na koniec kolejności
+  {
+    relink(node);
+    node->before = tail;
+    node->after = nullptr;
+    if(tail != nullptr)  tail->after = node;
+    else  head = node;
+    tail = node;
+    ++size;
+  }
+
+  void remove(HashNode* node) ///łańcuchy są krótkie - poprzednika szukamy od początku kubełka
+  {
+    HashNode **place = &table[fibonacciReduce(node->hashed, shift)];
+    while(*place != nullptr && *place != node)  place = &(*place)->next;
+    if(*place == nullptr) { ///w trakcie migracji węzeł może jeszcze być w starej tablicy
+      place = &old_table[fibonacciReduce(node->hashed, old_shift)];
+      while(*place != node)  place = &(*place)->next;
+    }
+    *place = node->next;
+
+    if(node->before != nullptr)  node->before->after = node->after;
+    else  head = node->after;
+    if(node->after != nullptr)  node->after->before = node->before;
+    else  tail = node->before;
+
+    destroyNode(node);
     --size;
+    migrate(step);
   }
 
-  HashNode* getNode(const key_type& key) const
+  ///kopiuje węzły w kolejności wstawiania; zapamiętane skróty wskazują kubełki bez haszowania,
+  ///węzły z nieprzeniesionej części starej tablicy oryginału trafiają od razu na swoje miejsce
+  void cloneTable(const HashMap& other)
   {
-    HashNode *node = table[hashFunction(key)];
-    while(node != nullptr)
-      if(node->value.first == key) return node;
+    if(real_size != other.real_size) {
+      HashNode **buckets = newTable(other.real_size);
+      deleteTable(table);
+      table = buckets;
+      real_size = other.real_size;
+      shift = other.shift;
+    }
+    ArenaTraits<NodeAllocator>::reserve(alloc, other.size);
+    for(HashNode *node = other.head; node != nullptr; node = node->after) {
+      HashNode *copy = createNode(node->value);
+      copy->hashed = node->hashed;
+      link(copy); ///na bieżąco - wyjątek w połowie zostawia spójną mapę
+    }
+  }
+
+  template <typename K>
+  HashNode* findInChain(HashNode* node, const K& key, std::size_t hashed) const ///skrót porównywany przed kluczem
+  {
+    for(; node != nullptr; node = node->next) {
+      AISDI_MAPS_COUNT(probes);
+      if(node->hashed != hashed)  continue;
+      AISDI_MAPS_COUNT(comparisons);
+      if(equal(node->value.first, key))  break;
+    }
     return node;
   }
 
-  std::pair<HashNode*, size_type> getFirst() const
+  template <typename K>
+  HashNode* findInOld(const K& key, std::size_t hashed) const ///tylko w trakcie migracji
   {
-    size_type index = 0;
+    size_type old_index = fibonacciReduce(hashed, old_shift);
+    if(old_index < migrated)  return nullptr;
+    return findInChain(old_table[old_index], key, hashed);
+  }
 
-    while(index < real_size && table[index] == nullptr)
-      ++index;
+  ///węzeł z kluczem (albo nullptr) i skrót klucza
+  template <typename K>
+  std::pair<HashNode*, std::size_t> locate(const K& key) const
+  {
+    AISDI_MAPS_COUNT(lookups);
+    std::size_t hashed = hash(key);
+    HashNode *node = findInChain(table[fibonacciReduce(hashed, shift)], key, hashed);
+    if(node == nullptr && old_table != nullptr)  node = findInOld(key, hashed);
+    return std::make_pair(node, hashed);
+  }
 
-    HashNode *node = nullptr;
-    if(index < real_size) node = table[index];
+  template <typename K>
+  HashNode* getNode(const K& key) const
+  {
+    return locate(key).first;
+  }
 
-    return std::make_pair(node, index);
+  bool grow(size_type count) ///powiększa tablicę gdy count elementów przekroczyłoby max_load
+  {
+    if(count <= real_size * max_load) return false;
+    size_type buckets = 2 * real_size;
+    while(count > buckets * max_load) buckets *= 2;
+    if(step == 0)  rehash(buckets);
+    else  startMigration(buckets);
+    return true;
+  }
+
+  enum { BatchGroup = 16 }; ///tyle wyszukiwań jest w locie jednocześnie
+
+  ///wyszukiwanie grupami: najpierw wszystkie skróty i prefetch kubełków, potem prefetch pierwszych węzłów
+  ///łańcuchów, na końcu porównania - chybienia w pamięci podręcznej nakładają się zamiast czekać jedno po drugim
+  template <typename Visit>
+  void probeBatch(const key_type* keys, size_type count, Visit visit) const
+  {
+    std::size_t hashes[BatchGroup];
+    HashNode *heads[BatchGroup];
+    AISDI_MAPS_COUNT_N(lookups, count);
+    for(size_type base = 0; base < count; base += BatchGroup) {
+      size_type group = std::min<size_type>(BatchGroup, count - base);
+      for(size_type i = 0; i < group; ++i) {
+        hashes[i] = hash(keys[base + i]);
+        prefetch(table + fibonacciReduce(hashes[i], shift));
+      }
+      for(size_type i = 0; i < group; ++i) {
+        heads[i] = table[fibonacciReduce(hashes[i], shift)];
+        if(heads[i] != nullptr)  prefetch(heads[i]);
+      }
+      for(size_type i = 0; i < group; ++i) {
+        HashNode *node = findInChain(heads[i], keys[base + i], hashes[i]);
+        if(node == nullptr && old_table != nullptr)  node = findInOld(keys[base + i], hashes[i]);
+        visit(base + i, node);
+      }
+    }
+  }
+
+  template <typename K, typename... Args>
+  std::pair<iterator, bool> tryEmplace(K&& key, Args&&... args)
+  {
+    migrate(step);
+    auto found = locate(key);
+    if(found.first != nullptr) return std::make_pair(iterator(this, found.first), false);
+
+    grow(size + 1);
+    HashNode *node = createNode(std::piecewise_construct, std::forward_as_tuple(std::forward<K>(key)),
+                                std::forward_as_tuple(std::forward<Args>(args)...));
+    node->hashed = found.second;
+    link(node);
+    return std::make_pair(iterator(this, node), true);
+  }
+
+  template <typename K, typename M>
+  std::pair<iterator, bool> insertOrAssign(K&& key, M&& mapped)
+  {
+    migrate(step);
+    auto found = locate(key);
+    if(found.first != nullptr) {
+      found.first->value.second = std::forward<M>(mapped);
+      return std::make_pair(iterator(this, found.first), false);
+    }
+
+    grow(size + 1);
+    HashNode *node = createNode(std::forward<K>(key), std::forward<M>(mapped));
+    node->hashed = found.second;
+    link(node);
+    return std::make_pair(iterator(this, node), true);
   }
 
 public:
-  HashMap() : table(nullptr), size(0), real_size(1000)
-  { table = new HashNode* [real_size]{nullptr}; }
+  HashMap() : HashMap(1024) {}
+
+  explicit HashMap(size_type buckets, const Hash& hash = Hash(), const KeyEqual& equal = KeyEqual(),
+                   const Allocator& allocator = Allocator())
+    : table(nullptr), head(nullptr), tail(nullptr), size(0), real_size(roundBuckets(buckets)), shift(shiftFor(real_size)), max_load(1.0f),
+      old_table(nullptr), old_size(0), old_shift(0), migrated(0), step(0), alloc(allocator), hash(hash), equal(equal)
+  { table = newTable(real_size); }
+
+  HashMap(size_type buckets, const Allocator& allocator) : HashMap(buckets, Hash(), KeyEqual(), allocator) {}
+
+  explicit HashMap(const Allocator& allocator) : HashMap(1024, allocator) {}
 
   HashMap(std::initializer_list<value_type> list) : HashMap()
   {
@@ -103,7 +373,9 @@ public:
       operator[]((*it).first) = (*it).second;
   }
 
-  HashMap(const HashMap& other) : HashMap() ///konstruktor kopiujący
+  HashMap(const HashMap& other) ///konstruktor kopiujący
+    : HashMap(other.real_size, other.hash, other.equal,
+              Allocator(NodeTraits::select_on_container_copy_construction(other.alloc)))
   {
     *this = other;
   }
@@ -116,15 +388,18 @@ public:
   ~HashMap()
   {
     erase();
-    delete[] table;
+    deleteTable(table);
   }
 
   HashMap& operator=(const HashMap& other) ///operator przypisania
   {
     if(this != &other) {
       erase();
-      for (auto it = other.begin(); it != other.end(); ++it)
-        operator[]((*it).first) = (*it).second;
+      hash = other.hash;
+      equal = other.equal;
+      max_load = other.max_load;
+      step = other.step;
+      cloneTable(other);
     }
     return *this;
   }
@@ -133,12 +408,21 @@ public:
   {
     if(this != &other) {
       erase();
-      auto temp = table;
-
-      table = other.table;
+      std::swap(table, other.table);
+      std::swap(head, other.head);
+      std::swap(tail, other.tail);
+      std::swap(real_size, other.real_size);
+      std::swap(shift, other.shift);
+      std::swap(max_load, other.max_load);
+      std::swap(old_table, other.old_table);
+      std::swap(old_size, other.old_size);
+      std::swap(old_shift, other.old_shift);
+      std::swap(migrated, other.migrated);
+      std::swap(step, other.step);
+      std::swap(alloc, other.alloc);
+      std::swap(hash, other.hash);
+      std::swap(equal, other.equal);
       size = other.size;
-
-      other.table = temp;
       other.size = 0;
     }
     return *this;
@@ -151,26 +435,53 @@ public:
 
   mapped_type& operator[](const key_type& key)
   {
-    size_type hashKey = hashFunction(key);
-    HashNode *node = table[hashKey];
+    return tryEmplace(key).first->second;
+  }
 
-    if(node == nullptr) {
-      table[hashKey] = new HashNode(key, mapped_type());
-      node = table[hashKey];
-      ++size;
-    }
-    else if(node->value.first != key){
-      while(node->next != nullptr) {
-        if(node->next->value.first == key) break;
-        else  node = node->next;
-      }
-      if(node->next == nullptr) {
-        node->next = new HashNode(key, mapped_type(), node);
-        ++size;
-      }
-      node = node->next;
+  mapped_type& operator[](key_type&& key)
+  {
+    return tryEmplace(std::move(key)).first->second;
+  }
+
+  template <typename... Args>
+  std::pair<iterator, bool> emplace(Args&&... args) ///węzeł powstaje przed sprawdzeniem klucza
+  {
+    HashNode *node = createNode(std::forward<Args>(args)...);
+    migrate(step);
+    auto found = locate(node->value.first);
+    if(found.first != nullptr) {
+      destroyNode(node);
+      return std::make_pair(iterator(this, found.first), false);
     }
-    return node->value.second;
+
+    grow(size + 1);
+    node->hashed = found.second;
+    link(node);
+    return std::make_pair(iterator(this, node), true);
+  }
+
+  template <typename... Args>
+  std::pair<iterator, bool> try_emplace(const key_type& key, Args&&... args)
+  {
+    return tryEmplace(key, std::forward<Args>(args)...);
+  }
+
+  template <typename... Args>
+  std::pair<iterator, bool> try_emplace(key_type&& key, Args&&... args)
+  {
+    return tryEmplace(std::move(key), std::forward<Args>(args)...);
+  }
+
+  template <typename M>
+  std::pair<iterator, bool> insert_or_assign(const key_type& key, M&& mapped)
+  {
+    return insertOrAssign(key, std::forward<M>(mapped));
+  }
+
+  template <typename M>
+  std::pair<iterator, bool> insert_or_assign(key_type&& key, M&& mapped)
+  {
+    return insertOrAssign(std::move(key), std::forward<M>(mapped));
   }
 
   const mapped_type& valueOf(const key_type& key) const
@@ -183,6 +494,7 @@ public:
 
   mapped_type& valueOf(const key_type& key)
   {
+    migrate(step);
     HashNode* node = getNode(key);
     if(node == nullptr)
       throw std::out_of_range("ValueOf is out of range.");
@@ -191,12 +503,15 @@ public:
 
   const_iterator find(const key_type& key) const
   {
-    return const_iterator(this, getNode(key), hashFunction(key));
+    auto found = locate(key);
+    return const_iterator(this, found.first);
   }
 
-  iterator find(const key_type& key)
+  iterator find(const key_type& key) ///jak każda zmiana mapy przesuwa migrację; wersja const nie
   {
-    return iterator(this, getNode(key), hashFunction(key));
+    migrate(step);
+    auto found = locate(key);
+    return iterator(this, found.first);
   }
 
   void remove(const key_type& key)
@@ -204,11 +519,67 @@ public:
     remove(find(key));
   }
 
+  template <typename K, typename = EnableLookup<K>>
+  const mapped_type& valueOf(const K& key) const
+  {
+    HashNode* node = getNode(key);
+    if(node == nullptr)
+      throw std::out_of_range("ValueOf is out of range.");
+    return node->value.second;
+  }
+
+  template <typename K, typename = EnableLookup<K>>
+  mapped_type& valueOf(const K& key)
+  {
+    migrate(step);
+    HashNode* node = getNode(key);
+    if(node == nullptr)
+      throw std::out_of_range("ValueOf is out of range.");
+    return node->value.second;
+  }
+
+  template <typename K, typename = EnableLookup<K>>
+  const_iterator find(const K& key) const
+  {
+    auto found = locate(key);
+    return const_iterator(this, found.first);
+  }
+
+  template <typename K, typename = EnableLookup<K>>
+  iterator find(const K& key)
+  {
+    migrate(step);
+    auto found = locate(key);
+    return iterator(this, found.first);
+  }
+
+  template <typename K, typename = EnableLookup<K>>
+  void remove(const K& key)
+  {
+    remove(find(key));
+  }
+
+  ///results[i] = find(keys[i]); opłaca się dla paczek od kilkudziesięciu kluczy wzwyż
+  void find_batch(const key_type* keys, size_type count, const_iterator* results) const
+  {
+    probeBatch(keys, count, [&](size_type i, HashNode* node) { results[i] = const_iterator(this, node); });
+  }
+
+  void find_batch(const key_type* keys, size_type count, iterator* results)
+  {
+    probeBatch(keys, count, [&](size_type i, HashNode* node) { results[i] = iterator(this, node); });
+  }
+
+  void contains_batch(const key_type* keys, size_type count, bool* results) const
+  {
+    probeBatch(keys, count, [&](size_type i, HashNode* node) { results[i] = node != nullptr; });
+  }
+
   void remove(const const_iterator& it)
   {
     if(this != it.mappu || it == end())
       throw std::out_of_range("Remove is out of range.");
-    remove(it.pointee, it.index);
+    remove(it.pointee);
   }
 
   size_type getSize() const
@@ -216,11 +587,125 @@ public:
     return size;
   }
 
+  allocator_type get_allocator() const
+  {
+    return allocator_type(alloc);
+  }
+
+  hasher hash_function() const
+  {
+    return hash;
+  }
+
+  key_equal key_eq() const
+  {
+    return equal;
+  }
+
+  size_type bucket_count() const
+  {
+    return real_size;
+  }
+
+  float load_factor() const
+  {
+    return static_cast<float>(size) / real_size;
+  }
+
+  float max_load_factor() const
+  {
+    return max_load;
+  }
+
+  void max_load_factor(float factor)
+  {
+    if(!(factor > 0))  throw std::invalid_argument("Max load factor must be positive.");
+    max_load = factor;
+    grow(size);
+  }
+
+  void rehash(size_type buckets) ///przepina istniejące węzły do nowej tablicy, bez ich realokacji; kończy migrację
+  {
+    migrate(old_size);
+    size_type minimal = static_cast<size_type>(std::ceil(size / max_load));
+    if(buckets < minimal) buckets = minimal;
+    buckets = roundBuckets(buckets);
+    if(buckets == real_size) return;
+
+    startMigration(buckets);
+    migrate(old_size);
+  }
+
+  ///tryb przyrostowy (jak dict w Redisie): powiększenie tylko przydziela nową tablicę, a każde wstawienie,
+  ///usunięcie, operator[] oraz find i valueOf na mapie nie-const przenoszą do niej buckets kolejnych kubełków
+  ///starej; wyszukiwania sprawdzają obie tablice, dopóki migracja trwa. Ogranicza najgorszy czas operacji.
+  ///Migracja tylko przepina łańcuchy kubełków, a iteratory idą po liście wstawiania, więc żadnego nie unieważnia.
+  ///0 (domyślnie) - rehash od razu w całości
+  void migration_step(size_type buckets)
+  {
+    step = buckets;
+    if(step == 0)  migrate(old_size);
+  }
+
+  size_type migration_step() const
+  {
+    return step;
+  }
+
+  bool rehashing() const ///czy trwa migracja do powiększonej tablicy
+  {
+    return old_table != nullptr;
+  }
+
+  HashMapStats stats() const ///przegląda całą tablicę - O(kubełki + size), nie do gorącej ścieżki
+  {
+    HashMapStats result;
+    result.size = size;
+    result.buckets = real_size;
+    result.old_buckets = old_table != nullptr ? old_size - migrated : 0;
+    result.load_factor = load_factor();
+    result.max_load_factor = max_load;
+    double probes = 0;
+    auto chain = [&](const HashNode* node) {
+      size_type length = 0;
+      for(; node != nullptr; node = node->next)  ++length;
+      if(length >= result.chain_lengths.size())  result.chain_lengths.resize(length + 1, 0);
+      ++result.chain_lengths[length];
+      probes += length * (length + 1) / 2.0; ///trafienie w k-te ogniwo kosztuje k porównań
+    };
+    for(size_type i = 0; i < real_size; ++i)  chain(table[i]);
+    for(size_type i = migrated; old_table != nullptr && i < old_size; ++i)  chain(old_table[i]);
+    result.empty_buckets = result.chain_lengths.empty() ? 0 : result.chain_lengths[0];
+    result.longest_chain = result.chain_lengths.empty() ? 0 : result.chain_lengths.size() - 1;
+    result.average_hit_probes = size ? probes / size : 0;
+    result.node_bytes = size * sizeof(HashNode);
+    result.table_bytes = (real_size + (old_table != nullptr ? old_size : 0)) * sizeof(HashNode*);
+    result.bytes = sizeof(*this) + result.node_bytes + result.table_bytes;
+#ifdef AISDI_MAPS_COUNTERS
+    result.counters = counters.load();
+#endif
+    return result;
+  }
+
+  void reset_counters() ///bez AISDI_MAPS_COUNTERS nic nie robi
+  {
+#ifdef AISDI_MAPS_COUNTERS
+    counters.reset();
+#endif
+  }
+
+  void reserve(size_type count)
+  {
+    size_type buckets = static_cast<size_type>(std::ceil(count / max_load));
+    if(buckets > real_size) rehash(buckets);
+  }
+
   bool operator==(const HashMap& other) const
   {
     if(size != other.size)  return false;
-    for(auto it = begin(), it2 = other.begin(); it!=end(); ++it, ++it2) {
-      if(*it != *it2) return false;
+    for(auto it = begin(); it != end(); ++it) { ///kolejność wstawiania obu map może być inna
+      HashNode *node = other.getNode(it->first);
+      if(node == nullptr || node->value.second != it->second) return false;
     }
     return true;
   }
@@ -230,10 +715,9 @@ public:
     return !(*this == other);
   }
 
-  iterator begin()
+  iterator begin() ///najstarszy element; iteracja idzie w kolejności wstawiania, O(1) na krok
   {
-    auto result = getFirst();
-    return iterator (this, result.first, result.second);
+    return iterator(this, head);
   }
 
   iterator end()
@@ -244,8 +728,7 @@ public:
 
   const_iterator cbegin() const
   {
-    auto result = getFirst();
-    return const_iterator (this, result.first, result.second);
+    return const_iterator(this, head);
   }
 
   const_iterator cend() const
@@ -265,8 +748,8 @@ public:
   }
 };
 
-template <typename KeyType, typename ValueType>
-class HashMap<KeyType, ValueType>::ConstIterator
+template <typename KeyType, typename ValueType, typename Hash, typename KeyEqual, typename Allocator>
+class HashMap<KeyType, ValueType, Hash, KeyEqual, Allocator>::ConstIterator
 {
 public:
   using reference = typename HashMap::const_reference;
@@ -277,32 +760,23 @@ public:
 protected:
   const HashMap *mappu;
   HashNode *pointee;
-  size_type index;
-  friend void HashMap<KeyType, ValueType>::remove(const const_iterator&);
+  friend void HashMap<KeyType, ValueType, Hash, KeyEqual, Allocator>::remove(const const_iterator&);
 
 public:
-  explicit ConstIterator(const HashMap *mappu = nullptr, HashNode *pointee = nullptr, size_type index = 0)
-  : mappu(mappu), pointee(pointee), index(index)
-  {
-    if(pointee == nullptr && mappu != nullptr)  this->index = mappu->real_size;
-  }
+  explicit ConstIterator(const HashMap *mappu = nullptr, HashNode *pointee = nullptr)
+  : mappu(mappu), pointee(pointee)
+  {}
 
   ConstIterator(const ConstIterator& other)
-  : ConstIterator(other.mappu, other.pointee, other.index)
+  : ConstIterator(other.mappu, other.pointee)
   {}
 
-  ConstIterator& operator++()
+  ConstIterator& operator=(const ConstIterator&) = default;
+
+  ConstIterator& operator++() ///w kolejności wstawiania, bez przeglądania pustych kubełków
   {
     if(mappu == nullptr || pointee == nullptr)  throw std::out_of_range("Operator++ is out of range.");
-    else if(pointee->next != nullptr){
-      pointee = pointee->next;
-    }
-    else {
-      index++;
-      while(index < mappu->real_size && mappu->table[index] == nullptr)  index++;
-      if(index >= mappu->real_size ) pointee = nullptr;
-      else  pointee = mappu->table[index];
-    }
+    pointee = pointee->after;
     return *this;
   }
 
@@ -316,16 +790,9 @@ public:
   ConstIterator& operator--()
   {
     if(mappu == nullptr)  throw std::out_of_range("Operator-- is out of range.");
-    else if(pointee == nullptr || pointee == mappu->table[index]) {
-      index--;
-      while(index > 0 && mappu->table[index] == nullptr) index--;
-      if(index == 0 && mappu->table[index] == nullptr)  throw std::out_of_range("Operator-- is out of range.");
-      pointee = mappu->table[index];
-      while (pointee->next != nullptr)  pointee = pointee->next;
-    }
-    else{
-      pointee = pointee->prev;
-    }
+    HashNode *previous = pointee == nullptr ? mappu->tail : pointee->before;
+    if(previous == nullptr)  throw std::out_of_range("Operator-- is out of range.");
+    pointee = previous;
     return *this;
   }
 
@@ -349,7 +816,7 @@ public:
 
   bool operator==(const ConstIterator& other) const
   {
-    return mappu == other.mappu && pointee == other.pointee && index == other.index;
+    return mappu == other.mappu && pointee == other.pointee;
   }
 
   bool operator!=(const ConstIterator& other) const
@@ -358,15 +825,16 @@ public:
   }
 };
 
-template <typename KeyType, typename ValueType> ///zrobione
-class HashMap<KeyType, ValueType>::Iterator : public HashMap<KeyType, ValueType>::ConstIterator
+template <typename KeyType, typename ValueType, typename Hash, typename KeyEqual, typename Allocator> ///zrobione
+class HashMap<KeyType, ValueType, Hash, KeyEqual, Allocator>::Iterator
+  : public HashMap<KeyType, ValueType, Hash, KeyEqual, Allocator>::ConstIterator
 {
 public:
   using reference = typename HashMap::reference;
   using pointer = typename HashMap::value_type*;
 
-  explicit Iterator(HashMap *mappu = nullptr, HashNode *pointee = nullptr, size_type index = 0)
-  : ConstIterator(mappu, pointee, index)
+  explicit Iterator(HashMap *mappu = nullptr, HashNode *pointee = nullptr)
+  : ConstIterator(mappu, pointee)
   {}
 
   Iterator(const ConstIterator& other)
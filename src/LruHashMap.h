@@ -0,0 +1,515 @@
+#ifndef AISDI_MAPS_LRUHASHMAP_H
+#define AISDI_MAPS_LRUHASHMAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "HashMap.h"
+#include "Stats.h"
+
+namespace aisdi
+{
+
+enum class Eviction
+{
+  Lru,   ///trafienie przepina węzeł na koniec listy - dokładna kolejność ostatnich użyć
+  Clock  ///trafienie tylko zapala bit w węźle; lista obracana dopiero przy wymianie (druga szansa)
+};
+
+///wartość w węźle pamięci podręcznej; w trybie CLOCK z bitem użycia, w LRU bez narzutu
+template <typename ValueType, bool Referenced>
+struct CacheEntry
+{
+  struct Emplace {}; ///odróżnia budowę wartości w miejscu od kopiowania całego CacheEntry
+
+  ValueType value;
+  bool referenced;
+
+  template <typename... Args>
+  explicit CacheEntry(Emplace, Args&&... args) : value(std::forward<Args>(args)...), referenced(false) {}
+};
+
+template <typename ValueType>
+struct CacheEntry<ValueType, false>
+{
+  struct Emplace {};
+
+  ValueType value;
+
+  template <typename... Args>
+  explicit CacheEntry(Emplace, Args&&... args) : value(std::forward<Args>(args)...) {}
+};
+
+///HashMap o stałej pojemności: wstawienie do pełnej mapy najpierw wyrzuca element wskazany przez politykę.
+///Kolejnością użyć jest lista kolejności wstawiania HashMap (before/after) - bez dodatkowych wskaźników.
+///find, valueOf i operator[] liczą trafienia i chybienia oraz oznaczają użycie; peek i contains nie.
+///Iteracja od następnej ofiary do ostatnio użytego (w CLOCK - do ostatnio wstawionego)
+template <typename KeyType, typename ValueType, Eviction Policy = Eviction::Lru,
+          typename Hash = aisdi::Hash<KeyType>, typename KeyEqual = EqualTo,
+          typename Allocator = std::allocator<std::pair<const KeyType, ValueType>>>
+class LruHashMap
+  : protected HashMap<KeyType, CacheEntry<ValueType, Policy == Eviction::Clock>, Hash, KeyEqual,
+                      typename std::allocator_traits<Allocator>::template
+                        rebind_alloc<std::pair<const KeyType, CacheEntry<ValueType, Policy == Eviction::Clock>>>>
+{
+  using Entry = CacheEntry<ValueType, Policy == Eviction::Clock>;
+  using EntryAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<std::pair<const KeyType, Entry>>;
+  using Base = HashMap<KeyType, Entry, Hash, KeyEqual, EntryAllocator>;
+  using HashNode = typename Base::HashNode;
+  using IsClock = std::integral_constant<bool, Policy == Eviction::Clock>;
+
+public:
+  using key_type = KeyType;
+  using mapped_type = ValueType;
+  using value_type = std::pair<const key_type, mapped_type>;
+  using size_type = std::size_t;
+  using reference = std::pair<const key_type&, mapped_type&>; ///wartość leży w CacheEntry
+  using const_reference = std::pair<const key_type&, const mapped_type&>;
+  using allocator_type = Allocator;
+  using hasher = Hash;
+  using key_equal = KeyEqual;
+
+  class ConstIterator;
+  class Iterator;
+  using iterator = Iterator;
+  using const_iterator = ConstIterator;
+
+  static constexpr Eviction eviction = Policy;
+
+private:
+  size_type limit;
+  std::uint64_t hits;
+  std::uint64_t misses;
+  std::uint64_t evictions;
+
+  template <typename K>
+  using EnableLookup = typename Base::template EnableLookup<K>;
+
+  void moveToBack(HashNode* node) ///O(1): wypięcie z listy kolejności i dopięcie na końcu
+  {
+    if(node == this->tail)  return;
+    if(node->before != nullptr)  node->before->after = node->after;
+    else  this->head = node->after;
+    node->after->before = node->before;
+    node->before = this->tail;
+    node->after = nullptr;
+    this->tail->after = node;
+    this->tail = node;
+  }
+
+  void touch(HashNode* node, std::false_type)
+  {
+    moveToBack(node);
+  }
+
+  void touch(HashNode* node, std::true_type) ///bez zapisu, gdy bit już zapalony - linia węzła zostaje czysta
+  {
+    if(!node->value.second.referenced)  node->value.second.referenced = true;
+  }
+
+  void evict(std::false_type)
+  {
+    Base::remove(this->head);
+    ++evictions;
+  }
+
+  void evict(std::true_type) ///wskazówka zegara to początek listy; każdy obrót gasi jeden bit, więc najwyżej size obrotów
+  {
+    while(this->head->value.second.referenced) {
+      this->head->value.second.referenced = false;
+      moveToBack(this->head);
+    }
+    Base::remove(this->head);
+    ++evictions;
+  }
+
+  template <typename K>
+  HashNode* use(const K& key)
+  {
+    HashNode *node = this->getNode(key);
+    if(node == nullptr) {
+      ++misses;
+      return nullptr;
+    }
+    ++hits;
+    touch(node, IsClock());
+    return node;
+  }
+
+  ///klucza nie ma (locate zwróciło nullptr i skrót); w pełnej mapie najpierw wymiana
+  template <typename K, typename... Args>
+  HashNode* insertNew(K&& key, std::size_t hashed, Args&&... args)
+  {
+    if(this->size >= limit)  evict(IsClock());
+    this->grow(this->size + 1);
+    HashNode *node = this->createNode(std::piecewise_construct, std::forward_as_tuple(std::forward<K>(key)),
+                                      std::forward_as_tuple(typename Entry::Emplace(), std::forward<Args>(args)...));
+    node->hashed = hashed;
+    this->link(node);
+    return node;
+  }
+
+  template <typename K>
+  mapped_type& access(K&& key)
+  {
+    auto found = this->locate(key);
+    if(found.first != nullptr) {
+      ++hits;
+      touch(found.first, IsClock());
+      return found.first->value.second.value;
+    }
+    ++misses;
+    return insertNew(std::forward<K>(key), found.second)->value.second.value;
+  }
+
+  template <typename K, typename... Args>
+  std::pair<iterator, bool> tryEmplace(K&& key, Args&&... args)
+  {
+    auto found = this->locate(key);
+    if(found.first != nullptr) {
+      touch(found.first, IsClock());
+      return std::make_pair(iterator(typename Base::iterator(this, found.first)), false);
+    }
+    HashNode *node = insertNew(std::forward<K>(key), found.second, std::forward<Args>(args)...);
+    return std::make_pair(iterator(typename Base::iterator(this, node)), true);
+  }
+
+  template <typename K, typename M>
+  std::pair<iterator, bool> insertOrAssign(K&& key, M&& mapped)
+  {
+    auto found = this->locate(key);
+    if(found.first != nullptr) {
+      found.first->value.second.value = std::forward<M>(mapped);
+      touch(found.first, IsClock());
+      return std::make_pair(iterator(typename Base::iterator(this, found.first)), false);
+    }
+    HashNode *node = insertNew(std::forward<K>(key), found.second, std::forward<M>(mapped));
+    return std::make_pair(iterator(typename Base::iterator(this, node)), true);
+  }
+
+public:
+  explicit LruHashMap(size_type capacity, const Hash& hash = Hash(), const KeyEqual& equal = KeyEqual(),
+                      const Allocator& allocator = Allocator())
+    : Base(capacity, hash, equal, EntryAllocator(allocator)), limit(capacity), hits(0), misses(0), evictions(0)
+  {
+    if(capacity == 0)  throw std::invalid_argument("Capacity must be positive.");
+  }
+
+  size_type capacity() const
+  {
+    return limit;
+  }
+
+  void capacity(size_type count) ///zmniejszenie od razu wyrzuca nadmiar w kolejności polityki
+  {
+    if(count == 0)  throw std::invalid_argument("Capacity must be positive.");
+    limit = count;
+    while(this->size > limit)  evict(IsClock());
+    this->reserve(limit);
+  }
+
+  size_type getSize() const
+  {
+    return this->size;
+  }
+
+  bool isEmpty() const
+  {
+    return this->size == 0;
+  }
+
+  mapped_type& operator[](const key_type& key)
+  {
+    return access(key);
+  }
+
+  mapped_type& operator[](key_type&& key)
+  {
+    return access(std::move(key));
+  }
+
+  template <typename... Args>
+  std::pair<iterator, bool> try_emplace(const key_type& key, Args&&... args)
+  {
+    return tryEmplace(key, std::forward<Args>(args)...);
+  }
+
+  template <typename... Args>
+  std::pair<iterator, bool> try_emplace(key_type&& key, Args&&... args)
+  {
+    return tryEmplace(std::move(key), std::forward<Args>(args)...);
+  }
+
+  template <typename M>
+  std::pair<iterator, bool> insert_or_assign(const key_type& key, M&& mapped)
+  {
+    return insertOrAssign(key, std::forward<M>(mapped));
+  }
+
+  template <typename M>
+  std::pair<iterator, bool> insert_or_assign(key_type&& key, M&& mapped)
+  {
+    return insertOrAssign(std::move(key), std::forward<M>(mapped));
+  }
+
+  mapped_type& valueOf(const key_type& key)
+  {
+    HashNode *node = use(key);
+    if(node == nullptr)  throw std::out_of_range("ValueOf is out of range.");
+    return node->value.second.value;
+  }
+
+  iterator find(const key_type& key)
+  {
+    return iterator(typename Base::iterator(this, use(key)));
+  }
+
+  const_iterator peek(const key_type& key) const ///bez oznaczania użycia i bez liczników
+  {
+    return const_iterator(typename Base::const_iterator(this, this->getNode(key)));
+  }
+
+  bool contains(const key_type& key) const
+  {
+    return this->getNode(key) != nullptr;
+  }
+
+  void remove(const key_type& key)
+  {
+    remove(peek(key));
+  }
+
+  template <typename K, typename = EnableLookup<K>>
+  mapped_type& valueOf(const K& key)
+  {
+    HashNode *node = use(key);
+    if(node == nullptr)  throw std::out_of_range("ValueOf is out of range.");
+    return node->value.second.value;
+  }
+
+  template <typename K, typename = EnableLookup<K>>
+  iterator find(const K& key)
+  {
+    return iterator(typename Base::iterator(this, use(key)));
+  }
+
+  template <typename K, typename = EnableLookup<K>>
+  const_iterator peek(const K& key) const
+  {
+    return const_iterator(typename Base::const_iterator(this, this->getNode(key)));
+  }
+
+  template <typename K, typename = EnableLookup<K>>
+  bool contains(const K& key) const
+  {
+    return this->getNode(key) != nullptr;
+  }
+
+  template <typename K, typename = EnableLookup<K>>
+  void remove(const K& key)
+  {
+    remove(peek(key));
+  }
+
+  void remove(const const_iterator& it)
+  {
+    Base::remove(it.it);
+  }
+
+  CacheStats stats() const
+  {
+    CacheStats result;
+    result.size = this->size;
+    result.capacity = limit;
+    result.hits = hits;
+    result.misses = misses;
+    result.evictions = evictions;
+    result.hit_rate = hits + misses ? static_cast<double>(hits) / (hits + misses) : 0;
+    return result;
+  }
+
+  HashMapStats table_stats() const ///stan tablicy pod spodem; O(kubełki + size)
+  {
+    return Base::stats();
+  }
+
+  void reset_counters()
+  {
+    hits = misses = evictions = 0;
+    Base::reset_counters();
+  }
+
+  iterator begin()
+  {
+    return iterator(Base::begin());
+  }
+
+  iterator end()
+  {
+    return iterator(Base::end());
+  }
+
+  const_iterator cbegin() const
+  {
+    return const_iterator(Base::cbegin());
+  }
+
+  const_iterator cend() const
+  {
+    return const_iterator(Base::cend());
+  }
+
+  const_iterator begin() const
+  {
+    return cbegin();
+  }
+
+  const_iterator end() const
+  {
+    return cend();
+  }
+};
+
+template <typename KeyType, typename ValueType, Eviction Policy, typename Hash, typename KeyEqual, typename Allocator>
+constexpr Eviction LruHashMap<KeyType, ValueType, Policy, Hash, KeyEqual, Allocator>::eviction;
+
+template <typename KeyType, typename ValueType, Eviction Policy, typename Hash, typename KeyEqual, typename Allocator>
+class LruHashMap<KeyType, ValueType, Policy, Hash, KeyEqual, Allocator>::ConstIterator
+{
+public:
+  using reference = typename LruHashMap::const_reference;
+  using iterator_category = std::bidirectional_iterator_tag;
+  using value_type = typename LruHashMap::value_type;
+  using difference_type = std::ptrdiff_t;
+
+  struct pointer ///operator-> musi zwrócić coś, co trzyma parę referencji
+  {
+    reference value;
+    const reference* operator->() const { return &value; }
+  };
+
+protected:
+  typename Base::const_iterator it;
+  friend class LruHashMap;
+
+public:
+  explicit ConstIterator(const typename Base::const_iterator& it = typename Base::const_iterator())
+  : it(it)
+  {}
+
+  ConstIterator& operator++()
+  {
+    ++it;
+    return *this;
+  }
+
+  ConstIterator operator++(int)
+  {
+    auto result = *this;
+    ++it;
+    return result;
+  }
+
+  ConstIterator& operator--()
+  {
+    --it;
+    return *this;
+  }
+
+  ConstIterator operator--(int)
+  {
+    auto result = *this;
+    --it;
+    return result;
+  }
+
+  reference operator*() const
+  {
+    const auto& value = *it;
+    return reference(value.first, value.second.value);
+  }
+
+  pointer operator->() const
+  {
+    return pointer{ operator*() };
+  }
+
+  bool operator==(const ConstIterator& other) const
+  {
+    return it == other.it;
+  }
+
+  bool operator!=(const ConstIterator& other) const
+  {
+    return !(*this == other);
+  }
+};
+
+template <typename KeyType, typename ValueType, Eviction Policy, typename Hash, typename KeyEqual, typename Allocator>
+class LruHashMap<KeyType, ValueType, Policy, Hash, KeyEqual, Allocator>::Iterator
+  : public LruHashMap<KeyType, ValueType, Policy, Hash, KeyEqual, Allocator>::ConstIterator
+{
+public:
+  using reference = typename LruHashMap::reference;
+
+  struct pointer
+  {
+    reference value;
+    const reference* operator->() const { return &value; }
+  };
+
+  explicit Iterator(const typename Base::const_iterator& it = typename Base::const_iterator())
+  : ConstIterator(it)
+  {}
+
+  Iterator(const ConstIterator& other)
+    : ConstIterator(other)
+  {}
+
+  Iterator& operator++()
+  {
+    ConstIterator::operator++();
+    return *this;
+  }
+
+  Iterator operator++(int)
+  {
+    auto result = *this;
+    ConstIterator::operator++();
+    return result;
+  }
+
+  Iterator& operator--()
+  {
+    ConstIterator::operator--();
+    return *this;
+  }
+
+  Iterator operator--(int)
+  {
+    auto result = *this;
+    ConstIterator::operator--();
+    return result;
+  }
+
+  reference operator*() const
+  {
+    auto& value = *typename Base::iterator(this->it);
+    return reference(value.first, value.second.value);
+  }
+
+  pointer operator->() const
+  {
+    return pointer{ operator*() };
+  }
+};
+
+}
+
+#endif /* AISDI_MAPS_LRUHASHMAP_H */
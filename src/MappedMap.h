@@ -0,0 +1,475 @@
+#ifndef AISDI_MAPS_MAPPEDMAP_H
+#define AISDI_MAPS_MAPPEDMAP_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Functional.h"
+#include "TreeMap.h"
+#include "HashMap.h"
+
+namespace aisdi
+{
+
+///snapshot na dysku: nagłówek, [tablica przesunięć kubełków], wpisy {klucz, wartość} wyrównane do 64 bajtów;
+///tylko typy trywialnie kopiowalne, kolejność bajtów i rozmiary typów muszą się zgadzać z piszącym
+namespace snapshot
+{
+
+const char magic[8] = { 'A', 'I', 'S', 'D', 'I', 'M', 'A', 'P' };
+const std::uint32_t version = 1;
+const std::uint32_t byte_order = 0x01020304;
+
+enum Kind : std::uint32_t { Sorted = 1, Hashed = 2 };
+
+struct Header
+{
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t byte_order;
+  std::uint32_t kind;
+  std::uint32_t entry_size;
+  std::uint32_t key_size;
+  std::uint32_t value_size;
+  std::uint64_t count;
+  std::uint64_t buckets;        ///tylko Hashed: potęga dwójki, przesunięcia zaczynają się zaraz za nagłówkiem
+  std::uint64_t hash_check;     ///skrót K() - inny hasher niż przy zapisie to błąd przy otwarciu
+  std::uint64_t entries_offset;
+};
+
+static_assert(sizeof(Header) == 64, "Snapshot header must stay 64 bytes.");
+
+template <typename K, typename V>
+struct Entry ///pola jak w std::pair, więc it->first / it->second działają tak samo jak w mapach
+{
+  K first;
+  V second;
+};
+
+template <typename K, typename V>
+struct Check
+{
+  static_assert(std::is_trivially_copyable<K>::value && std::is_trivially_copyable<V>::value,
+                "Snapshots require trivially copyable key and value types.");
+};
+
+inline std::uint64_t alignUp(std::uint64_t value)
+{
+  return (value + 63) / 64 * 64;
+}
+
+template <typename K, typename V>
+Header makeHeader(Kind kind, std::uint64_t count, std::uint64_t buckets, std::uint64_t hash_check)
+{
+  Header header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, magic, sizeof(magic));
+  header.version = version;
+  header.byte_order = byte_order;
+  header.kind = kind;
+  header.entry_size = sizeof(Entry<K, V>);
+  header.key_size = sizeof(K);
+  header.value_size = sizeof(V);
+  header.count = count;
+  header.buckets = buckets;
+  header.hash_check = hash_check;
+  header.entries_offset = alignUp(sizeof(Header) + (kind == Hashed ? (buckets + 1) * sizeof(std::uint64_t) : 0));
+  return header;
+}
+
+class Writer ///zapis do pliku tymczasowego i rename - czytelnicy nigdy nie widzą połowy snapshotu
+{
+public:
+  explicit Writer(const std::string& path) : path(path), temp(path + ".tmp"), out(temp, std::ios::binary | std::ios::trunc)
+  {
+    if(!out)  throw std::runtime_error("Cannot create snapshot " + temp + ".");
+  }
+
+  ~Writer()
+  {
+    if(!committed) {
+      out.close();
+      std::remove(temp.c_str());
+    }
+  }
+
+  void write(const void* data, std::size_t bytes)
+  {
+    out.write(static_cast<const char*>(data), bytes);
+  }
+
+  void padTo(std::uint64_t offset)
+  {
+    static const char zeros[64] = {};
+    std::uint64_t position = static_cast<std::uint64_t>(out.tellp());
+    if(position < offset)  write(zeros, offset - position);
+  }
+
+  void commit()
+  {
+    out.close();
+    if(!out || std::rename(temp.c_str(), path.c_str()) != 0)
+      throw std::runtime_error("Cannot write snapshot " + path + ".");
+    committed = true;
+  }
+
+private:
+  std::string path;
+  std::string temp;
+  std::ofstream out;
+  bool committed = false;
+};
+
+class MappedFile ///cały plik zmapowany tylko do odczytu; strony współdzielone z innymi procesami przez page cache
+{
+public:
+  MappedFile() : data(nullptr), length(0) {}
+
+  explicit MappedFile(const std::string& path) : MappedFile()
+  {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0)  throw std::runtime_error("Cannot open snapshot " + path + ".");
+    struct stat info;
+    if(::fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(Header))) {
+      ::close(fd);
+      throw std::runtime_error("Snapshot " + path + " is truncated.");
+    }
+    length = static_cast<std::size_t>(info.st_size);
+    void* address = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd); ///mapowanie trzyma plik, deskryptor nie jest już potrzebny
+    if(address == MAP_FAILED)  throw std::runtime_error("Cannot map snapshot " + path + ".");
+    data = static_cast<const char*>(address);
+  }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  MappedFile(MappedFile&& other) noexcept : data(other.data), length(other.length)
+  {
+    other.data = nullptr;
+    other.length = 0;
+  }
+
+  MappedFile& operator=(MappedFile&& other) noexcept
+  {
+    std::swap(data, other.data);
+    std::swap(length, other.length);
+    return *this;
+  }
+
+  ~MappedFile()
+  {
+    if(data != nullptr)  ::munmap(const_cast<char*>(data), length);
+  }
+
+  const char* bytes() const
+  {
+    return data;
+  }
+
+  std::size_t size() const
+  {
+    return length;
+  }
+
+private:
+  const char* data;
+  std::size_t length;
+};
+
+template <typename K, typename V>
+///Sorted: O(1) - tylko nagłówek i rozmiary; Hashed: O(kubełków) - find ufa tablicy przesunięć bez sprawdzania
+const Header& validate(const MappedFile& file, Kind kind, std::uint64_t hash_check)
+{
+  const Header& header = *reinterpret_cast<const Header*>(file.bytes());
+  if(std::memcmp(header.magic, magic, sizeof(magic)) != 0)  throw std::runtime_error("Not a map snapshot.");
+  if(header.version != version)  throw std::runtime_error("Unsupported snapshot version.");
+  if(header.byte_order != byte_order)  throw std::runtime_error("Snapshot written with a different byte order.");
+  if(header.kind != kind)  throw std::runtime_error("Snapshot holds a different kind of map.");
+  if(header.entry_size != sizeof(Entry<K, V>) || header.key_size != sizeof(K) || header.value_size != sizeof(V))
+    throw std::runtime_error("Snapshot was written for different key or value types.");
+  if(header.hash_check != hash_check)  throw std::runtime_error("Snapshot was written with a different hash function.");
+  if(header.entries_offset % 64 != 0 || header.entries_offset > file.size()
+     || header.count > (file.size() - header.entries_offset) / header.entry_size)
+    throw std::runtime_error("Snapshot is truncated.");
+  if(kind == Hashed) {
+    const std::uint64_t* offsets = reinterpret_cast<const std::uint64_t*>(file.bytes() + sizeof(Header));
+    if(header.buckets == 0 || (header.buckets & (header.buckets - 1)) != 0 || header.entries_offset < sizeof(Header)
+       || (header.entries_offset - sizeof(Header)) / sizeof(std::uint64_t) < header.buckets + 1
+       || offsets[header.buckets] != header.count)
+      throw std::runtime_error("Snapshot bucket table is corrupted.");
+    for(std::uint64_t bucket = 0; bucket < header.buckets; ++bucket)
+      if(offsets[bucket] > offsets[bucket + 1])  throw std::runtime_error("Snapshot bucket table is corrupted.");
+  }
+  return header;
+}
+
+}
+
+///widok tylko do odczytu na posortowaną tablicę wpisów: find/valueOf przez wyszukiwanie binarne
+template <typename KeyType, typename ValueType, typename Compare = Less>
+class MappedTreeMap : private snapshot::Check<KeyType, ValueType>
+{
+public:
+  using key_type = KeyType;
+  using mapped_type = ValueType;
+  using value_type = snapshot::Entry<KeyType, ValueType>;
+  using size_type = std::size_t;
+  using key_compare = Compare;
+  using const_iterator = const value_type*;
+  using iterator = const_iterator;
+
+  static MappedTreeMap open_mapped(const std::string& path, const Compare& compare = Compare())
+  {
+    return MappedTreeMap(snapshot::MappedFile(path), compare);
+  }
+
+  template <typename K>
+  const_iterator lower_bound(const K& key) const
+  {
+    return std::lower_bound(begin(), end(), key,
+                            [this](const value_type& entry, const K& value) { return compare(entry.first, value); });
+  }
+
+  template <typename K>
+  const_iterator upper_bound(const K& key) const
+  {
+    return std::upper_bound(begin(), end(), key,
+                            [this](const K& value, const value_type& entry) { return compare(value, entry.first); });
+  }
+
+  template <typename K>
+  const_iterator find(const K& key) const
+  {
+    const_iterator it = lower_bound(key);
+    return it != end() && !compare(key, it->first) ? it : end();
+  }
+
+  template <typename K>
+  const mapped_type& valueOf(const K& key) const
+  {
+    const_iterator it = find(key);
+    if(it == end())  throw std::out_of_range("ValueOf is out of range.");
+    return it->second;
+  }
+
+  size_type getSize() const
+  {
+    return count;
+  }
+
+  bool isEmpty() const
+  {
+    return count == 0;
+  }
+
+  const_iterator begin() const
+  {
+    return entries;
+  }
+
+  const_iterator end() const
+  {
+    return entries + count;
+  }
+
+  const_iterator cbegin() const
+  {
+    return begin();
+  }
+
+  const_iterator cend() const
+  {
+    return end();
+  }
+
+private:
+  MappedTreeMap(snapshot::MappedFile&& mapped, const Compare& compare) : file(std::move(mapped)), compare(compare)
+  {
+    const snapshot::Header& header = snapshot::validate<KeyType, ValueType>(file, snapshot::Sorted, 0);
+    entries = reinterpret_cast<const value_type*>(file.bytes() + header.entries_offset);
+    count = header.count;
+  }
+
+  snapshot::MappedFile file;
+  key_compare compare;
+  const value_type* entries;
+  size_type count;
+};
+
+///widok tylko do odczytu na tablicę kubełków: przesunięcia kubełków + wpisy ułożone kubełkami, kubełek jak w HashMap
+template <typename KeyType, typename ValueType, typename Hash = aisdi::Hash<KeyType>, typename KeyEqual = EqualTo>
+class MappedHashMap : private snapshot::Check<KeyType, ValueType>
+{
+public:
+  using key_type = KeyType;
+  using mapped_type = ValueType;
+  using value_type = snapshot::Entry<KeyType, ValueType>;
+  using size_type = std::size_t;
+  using hasher = Hash;
+  using key_equal = KeyEqual;
+  using const_iterator = const value_type*;
+  using iterator = const_iterator;
+
+  static MappedHashMap open_mapped(const std::string& path, const Hash& hash = Hash(), const KeyEqual& equal = KeyEqual())
+  {
+    return MappedHashMap(snapshot::MappedFile(path), hash, equal);
+  }
+
+  template <typename K>
+  const_iterator find(const K& key) const
+  {
+    size_type bucket = fibonacciReduce(hash(key), shift);
+    for(const value_type* it = entries + offsets[bucket], *stop = entries + offsets[bucket + 1]; it != stop; ++it)
+      if(equal(it->first, key))  return it;
+    return end();
+  }
+
+  template <typename K>
+  const mapped_type& valueOf(const K& key) const
+  {
+    const_iterator it = find(key);
+    if(it == end())  throw std::out_of_range("ValueOf is out of range.");
+    return it->second;
+  }
+
+  size_type getSize() const
+  {
+    return count;
+  }
+
+  bool isEmpty() const
+  {
+    return count == 0;
+  }
+
+  size_type bucket_count() const
+  {
+    return buckets;
+  }
+
+  const_iterator begin() const ///kolejność kubełków, jak w HashMap
+  {
+    return entries;
+  }
+
+  const_iterator end() const
+  {
+    return entries + count;
+  }
+
+  const_iterator cbegin() const
+  {
+    return begin();
+  }
+
+  const_iterator cend() const
+  {
+    return end();
+  }
+
+private:
+  MappedHashMap(snapshot::MappedFile&& mapped, const Hash& hash, const KeyEqual& equal)
+    : file(std::move(mapped)), hash(hash), equal(equal)
+  {
+    const snapshot::Header& header =
+      snapshot::validate<KeyType, ValueType>(file, snapshot::Hashed, this->hash(KeyType()));
+    offsets = reinterpret_cast<const std::uint64_t*>(file.bytes() + sizeof(snapshot::Header));
+    entries = reinterpret_cast<const value_type*>(file.bytes() + header.entries_offset);
+    count = header.count;
+    buckets = header.buckets;
+    shift = 0;
+    for(size_type value = buckets; value > 1; value >>= 1)  ++shift;
+    shift = 64 - shift;
+  }
+
+  snapshot::MappedFile file;
+  hasher hash;
+  key_equal equal;
+  const std::uint64_t* offsets;
+  const value_type* entries;
+  size_type count;
+  size_type buckets;
+  unsigned shift;
+};
+
+template <typename K, typename V, typename C, typename A, bool O>
+void save(const TreeMap<K, V, C, A, O>& map, const std::string& path) ///wpisy w kolejności kluczy, strumieniowo
+{
+  snapshot::Check<K, V> check;
+  (void)check;
+  snapshot::Header header = snapshot::makeHeader<K, V>(snapshot::Sorted, map.getSize(), 0, 0);
+  snapshot::Writer writer(path);
+  writer.write(&header, sizeof(header));
+  writer.padTo(header.entries_offset);
+
+  std::vector<snapshot::Entry<K, V>> chunk;
+  chunk.reserve(4096);
+  auto flush = [&]() {
+    writer.write(chunk.data(), chunk.size() * sizeof(snapshot::Entry<K, V>));
+    chunk.clear();
+  };
+  for(auto it = map.begin(); it != map.end(); ++it) {
+    snapshot::Entry<K, V> entry;
+    std::memset(&entry, 0, sizeof(entry)); ///wyzerowane wypełnienie - ten sam stan mapy daje ten sam plik
+    entry.first = it->first;
+    entry.second = it->second;
+    chunk.push_back(entry);
+    if(chunk.size() == chunk.capacity())  flush();
+  }
+  flush();
+  writer.commit();
+}
+
+template <typename K, typename V, typename H, typename E, typename A>
+void save(const HashMap<K, V, H, E, A>& map, const std::string& path) ///kubełki ułożone sortowaniem przez zliczanie
+{
+  snapshot::Check<K, V> check;
+  (void)check;
+  H hash = map.hash_function();
+  std::uint64_t buckets = 2;
+  while(buckets < map.getSize())  buckets *= 2;
+  unsigned shift = 64;
+  for(std::uint64_t value = buckets; value > 1; value >>= 1)  --shift;
+
+  std::vector<std::uint64_t> offsets(buckets + 1, 0);
+  for(auto it = map.begin(); it != map.end(); ++it)
+    ++offsets[fibonacciReduce(hash(it->first), shift) + 1];
+  for(std::uint64_t i = 0; i < buckets; ++i)
+    offsets[i + 1] += offsets[i];
+
+  std::vector<snapshot::Entry<K, V>> entries(map.getSize());
+  if(!entries.empty())  std::memset(static_cast<void*>(entries.data()), 0, entries.size() * sizeof(snapshot::Entry<K, V>));
+  std::vector<std::uint64_t> cursor(offsets.begin(), offsets.end() - 1);
+  for(auto it = map.begin(); it != map.end(); ++it) {
+    snapshot::Entry<K, V>& entry = entries[cursor[fibonacciReduce(hash(it->first), shift)]++];
+    entry.first = it->first;
+    entry.second = it->second;
+  }
+
+  snapshot::Header header = snapshot::makeHeader<K, V>(snapshot::Hashed, map.getSize(), buckets, hash(K()));
+  snapshot::Writer writer(path);
+  writer.write(&header, sizeof(header));
+  writer.write(offsets.data(), offsets.size() * sizeof(std::uint64_t));
+  writer.padTo(header.entries_offset);
+  writer.write(entries.data(), entries.size() * sizeof(snapshot::Entry<K, V>));
+  writer.commit();
+}
+
+}
+
+#endif /* AISDI_MAPS_MAPPEDMAP_H */
@@ -0,0 +1,265 @@
+#ifndef AISDI_MAPS_NODEPOOL_H
+#define AISDI_MAPS_NODEPOOL_H
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace aisdi
+{
+
+///pula bloków o stałym rozmiarze: kolejne bloki wycinane z ciągłych kawałków pamięci,
+///zwolnione bloki trafiają na listę wolnych; nie jest bezpieczna wątkowo
+class NodePool
+{
+public:
+  using size_type = std::size_t;
+
+  NodePool(size_type block_size, size_type alignment)
+  : free_list(nullptr), chunks(nullptr), cursor(nullptr), limit(nullptr), reserved(0),
+    block_size(blockSizeFor(block_size, alignment)), alignment(alignmentFor(alignment)), chunk_blocks(first_chunk)
+  {}
+
+  ///blok musi pomieścić wskaźnik listy wolnych, więc rozmiar i wyrównanie są co najmniej takie jak jego
+  static size_type alignmentFor(size_type alignment)
+  {
+    return alignment < alignof(FreeBlock) ? alignof(FreeBlock) : alignment;
+  }
+
+  static size_type blockSizeFor(size_type size, size_type alignment)
+  {
+    return roundUp(size < sizeof(FreeBlock) ? sizeof(FreeBlock) : size, alignmentFor(alignment));
+  }
+
+  NodePool(const NodePool&) = delete;
+  NodePool& operator=(const NodePool&) = delete;
+
+  ~NodePool()
+  {
+    release();
+  }
+
+  void* allocate()
+  {
+    if(free_list != nullptr && reserved == 0) {
+      FreeBlock* block = free_list;
+      free_list = block->next;
+      return block;
+    }
+    if(cursor == limit) grow(chunk_blocks);
+    if(reserved != 0) --reserved;
+    void* block = cursor;
+    cursor += block_size;
+    return block;
+  }
+
+  void deallocate(void* pointer)
+  {
+    FreeBlock* block = static_cast<FreeBlock*>(pointer);
+    block->next = free_list;
+    free_list = block;
+  }
+
+  ///kolejne blocks alokacji trafi po kolei do jednego ciągłego kawałka - także gdy lista wolnych nie jest pusta;
+  ///z listy wolnych (tam też idzie resztka bieżącego kawałka) pula bierze dopiero potem
+  void reserve(size_type blocks)
+  {
+    if(static_cast<size_type>(limit - cursor) < blocks * block_size) {
+      for(; cursor != limit; cursor += block_size)
+        deallocate(cursor);
+      grow(blocks);
+    }
+    reserved = blocks;
+  }
+
+  void release() ///zwalnia wszystkie kawałki naraz, bez przechodzenia po blokach
+  {
+    while(chunks != nullptr) {
+      Chunk* next = chunks->next;
+      freeChunk(chunks);
+      chunks = next;
+    }
+    free_list = nullptr;
+    cursor = limit = nullptr;
+    reserved = 0;
+    chunk_blocks = first_chunk;
+  }
+
+  size_type blockSize() const
+  {
+    return block_size;
+  }
+
+  size_type blockAlignment() const
+  {
+    return alignment;
+  }
+
+private:
+  struct FreeBlock { FreeBlock* next; };
+  struct Chunk { Chunk* next; };
+
+  static const size_type first_chunk = 64;
+  static const size_type max_chunk = 1 << 16;
+
+  static size_type roundUp(size_type value, size_type alignment)
+  {
+    return (value + alignment - 1) / alignment * alignment;
+  }
+
+  ///zwykły operator new gwarantuje tylko __STDCPP_DEFAULT_NEW_ALIGNMENT__; większe wyrównanie od C++17
+  ///przez align_val_t, a wcześniej PoolAllocator go nie przyjmuje
+  void* allocateChunk(size_type bytes) const
+  {
+#ifdef __cpp_aligned_new
+    if(alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__)  return ::operator new(bytes, std::align_val_t(alignment));
+#endif
+    return ::operator new(bytes);
+  }
+
+  void freeChunk(Chunk* chunk) const
+  {
+#ifdef __cpp_aligned_new
+    if(alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+      ::operator delete(chunk, std::align_val_t(alignment));
+      return;
+    }
+#endif
+    ::operator delete(chunk);
+  }
+
+  void grow(size_type blocks)
+  {
+    size_type header = roundUp(sizeof(Chunk), alignment);
+    char* memory = static_cast<char*>(allocateChunk(header + blocks * block_size));
+    Chunk* chunk = reinterpret_cast<Chunk*>(memory);
+    chunk->next = chunks;
+    chunks = chunk;
+    cursor = memory + header;
+    limit = cursor + blocks * block_size;
+    if(chunk_blocks < max_chunk) chunk_blocks *= 2;
+  }
+
+  FreeBlock* free_list;
+  Chunk* chunks;
+  char* cursor;
+  char* limit;
+  size_type reserved;     ///tyle najbliższych alokacji bierze z kawałka, z pominięciem listy wolnych
+  size_type block_size;
+  size_type alignment;
+  size_type chunk_blocks;
+};
+
+class NodeArena ///zbiór pul, po jednej na rozmiar i wyrównanie bloku; współdzielony przez kopie i rebind alokatora
+{
+public:
+  NodePool& pool(std::size_t block_size, std::size_t alignment)
+  {
+    const std::size_t size = NodePool::blockSizeFor(block_size, alignment);
+    alignment = NodePool::alignmentFor(alignment);
+    for(auto it = pools.begin(); it != pools.end(); ++it)
+      if((*it)->blockSize() == size && (*it)->blockAlignment() == alignment) return **it;
+    pools.emplace_back(new NodePool(block_size, alignment));
+    return *pools.back();
+  }
+
+  void release()
+  {
+    for(auto it = pools.begin(); it != pools.end(); ++it)
+      (*it)->release();
+  }
+
+private:
+  std::vector<std::unique_ptr<NodePool>> pools;
+};
+
+template <typename T>
+class PoolAllocator
+{
+#ifndef __cpp_aligned_new
+  static_assert(alignof(T) <= alignof(std::max_align_t), "PoolAllocator needs C++17 aligned new for over-aligned types");
+#endif
+
+public:
+  using value_type = T;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap = std::true_type;
+
+  PoolAllocator() : arena(std::make_shared<NodeArena>()), pool(&arena->pool(sizeof(T), alignof(T))) {}
+
+  template <typename U>
+  PoolAllocator(const PoolAllocator<U>& other) : arena(other.arena), pool(&arena->pool(sizeof(T), alignof(T))) {}
+
+  T* allocate(std::size_t n)
+  {
+    if(n == 1) return static_cast<T*>(pool->allocate());
+    return static_cast<T*>(::operator new(n * sizeof(T)));
+  }
+
+  void deallocate(T* pointer, std::size_t n)
+  {
+    if(n == 1) pool->deallocate(pointer);
+    else  ::operator delete(pointer);
+  }
+
+  PoolAllocator select_on_container_copy_construction() const ///kopia kontenera dostaje własną arenę
+  {
+    return PoolAllocator();
+  }
+
+  void reserve(std::size_t n)
+  {
+    pool->reserve(n);
+  }
+
+  bool exclusive() const ///arena należy tylko do tego alokatora
+  {
+    return arena.use_count() == 1;
+  }
+
+  void release()
+  {
+    arena->release();
+  }
+
+  template <typename U>
+  bool operator==(const PoolAllocator<U>& other) const
+  {
+    return arena == other.arena;
+  }
+
+  template <typename U>
+  bool operator!=(const PoolAllocator<U>& other) const
+  {
+    return arena != other.arena;
+  }
+
+private:
+  template <typename U> friend class PoolAllocator;
+
+  std::shared_ptr<NodeArena> arena;
+  NodePool* pool;
+};
+
+///pozwala kontenerom zwolnić wszystkie węzły jednym ruchem, jeśli alokator to umożliwia
+template <typename Allocator>
+struct ArenaTraits
+{
+  static bool exclusive(const Allocator&) { return false; }
+  static void release(Allocator&) {}
+  static void reserve(Allocator&, std::size_t) {}
+};
+
+template <typename T>
+struct ArenaTraits<PoolAllocator<T>>
+{
+  static bool exclusive(const PoolAllocator<T>& alloc) { return alloc.exclusive(); }
+  static void release(PoolAllocator<T>& alloc) { alloc.release(); }
+  static void reserve(PoolAllocator<T>& alloc, std::size_t n) { alloc.reserve(n); }
+};
+
+}
+
+#endif /* AISDI_MAPS_NODEPOOL_H */
@@ -0,0 +1,566 @@
+#ifndef AISDI_MAPS_PERSISTENTTREEMAP_H
+#define AISDI_MAPS_PERSISTENTTREEMAP_H
+
+#include <algorithm>
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Functional.h"
+
+namespace aisdi
+{
+
+template <typename KeyType, typename ValueType, typename Compare>
+class PersistentTreeMap;
+
+///niezmienna wersja drzewa AVL: węzły współdzielone przez shared_ptr z kolejnymi wersjami, zwalniane,
+///gdy nie wskazuje ich już żadna wersja. Kopia w O(1); czytanie i iteracja bez blokad, z dowolnego wątku.
+///Iteratory ważne, dopóki istnieje wersja, z której pochodzą
+template <typename KeyType, typename ValueType, typename Compare = Less>
+class TreeSnapshot
+{
+public:
+  using key_type = KeyType;
+  using mapped_type = ValueType;
+  using value_type = std::pair<const key_type, mapped_type>;
+  using size_type = std::size_t;
+  using reference = const value_type&;
+  using const_reference = const value_type&;
+  using key_compare = Compare;
+
+  class ConstIterator;
+  using const_iterator = ConstIterator;
+  using iterator = ConstIterator;
+
+protected:
+  struct Node;
+  using NodePtr = std::shared_ptr<const Node>;
+
+  struct Node ///po zbudowaniu nie zmienia się nigdy - zmiana to nowy węzeł
+  {
+    value_type value;
+    NodePtr left, right;
+    int height;
+    size_type count; ///węzłów w poddrzewie; w korzeniu to rozmiar wersji
+    template <typename... Args>
+    Node(NodePtr left, NodePtr right, Args&&... args)
+      : value(std::forward<Args>(args)...), left(std::move(left)), right(std::move(right)),
+        height(1 + std::max(heightOf(this->left.get()), heightOf(this->right.get()))),
+        count(1 + countOf(this->left.get()) + countOf(this->right.get())) {}
+  };
+
+  NodePtr root;
+  key_compare compare;
+  friend class PersistentTreeMap<KeyType, ValueType, Compare>; ///snapshot() buduje wersję z własnego korzenia
+
+  template <typename K> ///wyszukiwanie po typie porównywalnym z kluczem, bez tworzenia key_type
+  using EnableLookup = typename std::enable_if<IsTransparent<key_compare>::value
+                                               && !std::is_convertible<const K&, const_iterator>::value>::type;
+
+  TreeSnapshot(NodePtr root, const Compare& compare) : root(std::move(root)), compare(compare) {}
+
+  static int heightOf(const Node* node)
+  {
+    return node != nullptr ? node->height : 0;
+  }
+
+  static size_type countOf(const Node* node)
+  {
+    return node != nullptr ? node->count : 0;
+  }
+
+  template <typename K>
+  const Node* getNode(const K& key) const
+  {
+    const Node *node = root.get();
+    while(node != nullptr) {
+      if(compare(key, node->value.first))  node = node->left.get();
+      else if(compare(node->value.first, key))  node = node->right.get();
+      else  break;
+    }
+    return node;
+  }
+
+  template <typename K>
+  const_iterator lowerBound(const K& key) const ///ścieżka do pierwszego klucza >= key
+  {
+    const_iterator it(root.get());
+    it.reservePath();
+    size_type keep = 0;
+    for(const Node *node = root.get(); node != nullptr; ) {
+      it.path.push_back(node);
+      if(compare(node->value.first, key))  node = node->right.get();
+      else {
+        keep = it.path.size();
+        node = node->left.get();
+      }
+    }
+    it.path.resize(keep);
+    return it;
+  }
+
+  template <typename K>
+  const_iterator upperBound(const K& key) const ///ścieżka do pierwszego klucza > key
+  {
+    const_iterator it(root.get());
+    it.reservePath();
+    size_type keep = 0;
+    for(const Node *node = root.get(); node != nullptr; ) {
+      it.path.push_back(node);
+      if(!compare(key, node->value.first))  node = node->right.get();
+      else {
+        keep = it.path.size();
+        node = node->left.get();
+      }
+    }
+    it.path.resize(keep);
+    return it;
+  }
+
+  template <typename K>
+  const_iterator findIterator(const K& key) const
+  {
+    const_iterator it = lowerBound(key);
+    if(!it.path.empty() && compare(key, it.path.back()->value.first))  it.path.clear();
+    return it;
+  }
+
+public:
+  TreeSnapshot() = default;
+
+  explicit TreeSnapshot(const Compare& compare) : compare(compare) {}
+
+  size_type getSize() const
+  {
+    return countOf(root.get());
+  }
+
+  bool isEmpty() const
+  {
+    return root == nullptr;
+  }
+
+  int height() const
+  {
+    return heightOf(root.get());
+  }
+
+  key_compare key_comp() const
+  {
+    return compare;
+  }
+
+  const mapped_type& valueOf(const key_type& key) const
+  {
+    const Node *node = getNode(key);
+    if(node == nullptr)  throw std::out_of_range("ValueOf is out of range.");
+    return node->value.second;
+  }
+
+  const_iterator find(const key_type& key) const
+  {
+    return findIterator(key);
+  }
+
+  bool contains(const key_type& key) const
+  {
+    return getNode(key) != nullptr;
+  }
+
+  const_iterator lower_bound(const key_type& key) const
+  {
+    return lowerBound(key);
+  }
+
+  const_iterator upper_bound(const key_type& key) const
+  {
+    return upperBound(key);
+  }
+
+  template <typename K, typename = EnableLookup<K>>
+  const mapped_type& valueOf(const K& key) const
+  {
+    const Node *node = getNode(key);
+    if(node == nullptr)  throw std::out_of_range("ValueOf is out of range.");
+    return node->value.second;
+  }
+
+  template <typename K, typename = EnableLookup<K>>
+  const_iterator find(const K& key) const
+  {
+    return findIterator(key);
+  }
+
+  template <typename K, typename = EnableLookup<K>>
+  bool contains(const K& key) const
+  {
+    return getNode(key) != nullptr;
+  }
+
+  template <typename K, typename = EnableLookup<K>>
+  const_iterator lower_bound(const K& key) const
+  {
+    return lowerBound(key);
+  }
+
+  template <typename K, typename = EnableLookup<K>>
+  const_iterator upper_bound(const K& key) const
+  {
+    return upperBound(key);
+  }
+
+  bool operator==(const TreeSnapshot& other) const ///ta sama wersja rozpoznana od razu, bez przeglądania
+  {
+    if(root == other.root)  return true;
+    if(getSize() != other.getSize())  return false;
+    for(auto it = begin(), jt = other.begin(); it != end(); ++it, ++jt)
+      if(compare(it->first, jt->first) || compare(jt->first, it->first) || it->second != jt->second)  return false;
+    return true;
+  }
+
+  bool operator!=(const TreeSnapshot& other) const
+  {
+    return !(*this == other);
+  }
+
+  const_iterator cbegin() const
+  {
+    const_iterator it(root.get());
+    it.reservePath();
+    for(const Node *node = root.get(); node != nullptr; node = node->left.get())  it.path.push_back(node);
+    return it;
+  }
+
+  const_iterator cend() const
+  {
+    return const_iterator(root.get());
+  }
+
+  const_iterator begin() const
+  {
+    return cbegin();
+  }
+
+  const_iterator end() const
+  {
+    return cend();
+  }
+};
+
+template <typename KeyType, typename ValueType, typename Compare>
+class TreeSnapshot<KeyType, ValueType, Compare>::ConstIterator
+{
+public:
+  using reference = typename TreeSnapshot::const_reference;
+  using iterator_category = std::bidirectional_iterator_tag;
+  using value_type = typename TreeSnapshot::value_type;
+  using pointer = const typename TreeSnapshot::value_type*;
+  using difference_type = std::ptrdiff_t;
+
+private:
+  const Node *root;
+  std::vector<const Node*> path; ///od korzenia do bieżącego węzła, bo węzły nie znają rodziców; pusta - koniec
+  friend class TreeSnapshot;
+
+  void reservePath() ///jedna alokacja na całą wędrówkę - ścieżka nie bywa dłuższa niż wysokość
+  {
+    path.reserve(heightOf(root));
+  }
+
+public:
+  explicit ConstIterator(const Node *root = nullptr) ///koniec - bez alokacji, bo end() bywa tworzone w każdym kroku pętli
+  : root(root)
+  {}
+
+  ConstIterator& operator++() ///następnik: skrajnie lewy w prawym poddrzewie albo przodek, do którego wracamy z lewej
+  {
+    if(path.empty())  throw std::out_of_range("Operator++ is out of range.");
+    const Node *node = path.back();
+    if(node->right != nullptr) {
+      for(node = node->right.get(); node != nullptr; node = node->left.get())  path.push_back(node);
+      return *this;
+    }
+    size_type depth = path.size() - 1;
+    while(depth > 0 && path[depth - 1]->right.get() == path[depth])  --depth;
+    path.resize(depth);
+    return *this;
+  }
+
+  ConstIterator operator++(int)
+  {
+    auto result = *this;
+    operator++();
+    return result;
+  }
+
+  ConstIterator& operator--()
+  {
+    if(path.empty()) {
+      if(root == nullptr)  throw std::out_of_range("Operator-- is out of range.");
+      reservePath();
+      for(const Node *node = root; node != nullptr; node = node->right.get())  path.push_back(node);
+      return *this;
+    }
+    const Node *node = path.back();
+    if(node->left != nullptr) {
+      for(node = node->left.get(); node != nullptr; node = node->right.get())  path.push_back(node);
+      return *this;
+    }
+    size_type depth = path.size() - 1;
+    while(depth > 0 && path[depth - 1]->left.get() == path[depth])  --depth;
+    if(depth == 0)  throw std::out_of_range("Operator-- is out of range.");
+    path.resize(depth);
+    return *this;
+  }
+
+  ConstIterator operator--(int)
+  {
+    auto result = *this;
+    operator--();
+    return result;
+  }
+
+  reference operator*() const
+  {
+    if(path.empty())  throw std::out_of_range("Operator* is out of range.");
+    return path.back()->value;
+  }
+
+  pointer operator->() const
+  {
+    return &this->operator*();
+  }
+
+  bool operator==(const ConstIterator& other) const
+  {
+    return root == other.root && (path.empty() ? nullptr : path.back()) == (other.path.empty() ? nullptr : other.path.back());
+  }
+
+  bool operator!=(const ConstIterator& other) const
+  {
+    return !(*this == other);
+  }
+};
+
+///TreeMap z kopiowaniem ścieżki: zmiana tworzy nowe kopie tylko O(log n) węzłów na drodze od korzenia,
+///resztę dzieli z poprzednią wersją. snapshot() zwraca w O(1) niezmienną wersję do czytania w innych wątkach,
+///także podczas kolejnych zmian. Jeden pisarz naraz; poza snapshot() mapy nie czyta się z innych wątków.
+///Zmiana unieważnia iteratory samej mapy, ale nie iteratory wcześniej pobranych wersji
+template <typename KeyType, typename ValueType, typename Compare = Less>
+class PersistentTreeMap : public TreeSnapshot<KeyType, ValueType, Compare>
+{
+  using Base = TreeSnapshot<KeyType, ValueType, Compare>;
+  using Node = typename Base::Node;
+  using NodePtr = typename Base::NodePtr;
+
+public:
+  using Snapshot = Base;
+  using typename Base::key_type;
+  using typename Base::mapped_type;
+  using typename Base::value_type;
+  using typename Base::size_type;
+  using typename Base::const_iterator;
+  using typename Base::iterator;
+
+private:
+  template <typename It>
+  using RequireIterator = typename std::iterator_traits<It>::iterator_category;
+
+  template <typename... Args>
+  static NodePtr makeNode(NodePtr left, NodePtr right, Args&&... args)
+  {
+    return std::make_shared<const Node>(std::move(left), std::move(right), std::forward<Args>(args)...);
+  }
+
+  ///nowy węzeł z value między left i right; gdy wysokości różnią się o 2, jedna albo dwie rotacje -
+  ///też na nowych węzłach, bo stare mogą należeć do innych wersji
+  static NodePtr balance(const value_type& value, NodePtr left, NodePtr right)
+  {
+    const int left_height = Base::heightOf(left.get()), right_height = Base::heightOf(right.get());
+    if(left_height > right_height + 1) {
+      const Node *pivot = left.get();
+      if(Base::heightOf(pivot->left.get()) >= Base::heightOf(pivot->right.get()))
+        return makeNode(pivot->left, makeNode(pivot->right, std::move(right), value), pivot->value);
+      const Node *inner = pivot->right.get();
+      return makeNode(makeNode(pivot->left, inner->left, pivot->value),
+                      makeNode(inner->right, std::move(right), value), inner->value);
+    }
+    if(right_height > left_height + 1) {
+      const Node *pivot = right.get();
+      if(Base::heightOf(pivot->right.get()) >= Base::heightOf(pivot->left.get()))
+        return makeNode(makeNode(std::move(left), pivot->left, value), pivot->right, pivot->value);
+      const Node *inner = pivot->left.get();
+      return makeNode(makeNode(std::move(left), inner->left, value),
+                      makeNode(inner->right, pivot->right, pivot->value), inner->value);
+    }
+    return makeNode(std::move(left), std::move(right), value);
+  }
+
+  ///poddrzewo z kluczem; zwraca ten sam wskaźnik, gdy nic się nie zmieniło - wtedy ścieżka nie jest kopiowana
+  template <typename K, typename... Args>
+  NodePtr insertInto(const NodePtr& node, bool assign, bool& inserted, K&& key, Args&&... args) const
+  {
+    if(node == nullptr) {
+      inserted = true;
+      return makeNode(nullptr, nullptr, std::piecewise_construct, std::forward_as_tuple(std::forward<K>(key)),
+                      std::forward_as_tuple(std::forward<Args>(args)...));
+    }
+    if(this->compare(key, node->value.first)) {
+      NodePtr left = insertInto(node->left, assign, inserted, std::forward<K>(key), std::forward<Args>(args)...);
+      return left == node->left ? node : balance(node->value, std::move(left), node->right);
+    }
+    if(this->compare(node->value.first, key)) {
+      NodePtr right = insertInto(node->right, assign, inserted, std::forward<K>(key), std::forward<Args>(args)...);
+      return right == node->right ? node : balance(node->value, node->left, std::move(right));
+    }
+    if(!assign)  return node;
+    return makeNode(node->left, node->right, std::piecewise_construct, std::forward_as_tuple(node->value.first),
+                    std::forward_as_tuple(std::forward<Args>(args)...));
+  }
+
+  static NodePtr removeMin(const NodePtr& node, const Node*& minimum) ///minimum żyje, dopóki żyje node
+  {
+    if(node->left == nullptr) {
+      minimum = node.get();
+      return node->right;
+    }
+    return balance(node->value, removeMin(node->left, minimum), node->right);
+  }
+
+  template <typename K>
+  NodePtr removeFrom(const NodePtr& node, const K& key) const ///ten sam wskaźnik, gdy klucza nie było
+  {
+    if(node == nullptr)  return node;
+    if(this->compare(key, node->value.first)) {
+      NodePtr left = removeFrom(node->left, key);
+      return left == node->left ? node : balance(node->value, std::move(left), node->right);
+    }
+    if(this->compare(node->value.first, key)) {
+      NodePtr right = removeFrom(node->right, key);
+      return right == node->right ? node : balance(node->value, node->left, std::move(right));
+    }
+    if(node->left == nullptr)  return node->right;
+    if(node->right == nullptr)  return node->left;
+    const Node *successor = nullptr;
+    NodePtr right = removeMin(node->right, successor);
+    return balance(successor->value, node->left, std::move(right));
+  }
+
+  void publish(NodePtr fresh) ///czytelnicy w snapshot() widzą starą albo nową wersję, nigdy stan pośredni
+  {
+    std::atomic_store(&this->root, std::move(fresh));
+  }
+
+  ///drzewo idealnie zrównoważone z count kolejnych, ściśle rosnących kluczy, in-order w O(n)
+  template <typename It>
+  static NodePtr buildBalanced(It& it, size_type count)
+  {
+    if(count == 0)  return nullptr;
+    NodePtr left = buildBalanced(it, count / 2);
+    const value_type& value = *it;
+    ++it;
+    NodePtr right = buildBalanced(it, count - count / 2 - 1);
+    return makeNode(std::move(left), std::move(right), value);
+  }
+
+  template <typename It>
+  void assign(It first, It last, std::input_iterator_tag)
+  {
+    for(; first != last; ++first)  try_emplace(first->first, first->second);
+  }
+
+  template <typename It>
+  void assign(It first, It last, std::forward_iterator_tag) ///posortowane wejście bez powtórzeń - w O(n)
+  {
+    size_type count = 0;
+    for(It it = first, prev = first; it != last; prev = it, ++it, ++count)
+      if(count > 0 && !this->compare(prev->first, it->first))
+        return assign(first, last, std::input_iterator_tag());
+    publish(buildBalanced(first, count));
+  }
+
+public:
+  PersistentTreeMap() = default;
+
+  explicit PersistentTreeMap(const Compare& compare) : Base(compare) {}
+
+  PersistentTreeMap(std::initializer_list<value_type> list) : PersistentTreeMap(list.begin(), list.end()) {}
+
+  ///z powtórzeń klucza zostaje pierwsze, jak w TreeMap
+  template <typename It, typename = RequireIterator<It>>
+  PersistentTreeMap(It first, It last, const Compare& compare = Compare())
+    : Base(compare)
+  {
+    assign(first, last, RequireIterator<It>());
+  }
+
+  Snapshot snapshot() const ///O(1), bezpieczne równolegle ze zmianami pisarza
+  {
+    return Snapshot(std::atomic_load(&this->root), this->compare);
+  }
+
+  template <typename... Args>
+  bool try_emplace(const key_type& key, Args&&... args) ///true, gdy wstawiono
+  {
+    bool inserted = false;
+    NodePtr fresh = insertInto(this->root, false, inserted, key, std::forward<Args>(args)...);
+    if(inserted)  publish(std::move(fresh));
+    return inserted;
+  }
+
+  template <typename... Args>
+  bool try_emplace(key_type&& key, Args&&... args)
+  {
+    bool inserted = false;
+    NodePtr fresh = insertInto(this->root, false, inserted, std::move(key), std::forward<Args>(args)...);
+    if(inserted)  publish(std::move(fresh));
+    return inserted;
+  }
+
+  template <typename M>
+  bool insert_or_assign(const key_type& key, M&& mapped) ///true, gdy wstawiono, false - gdy nadpisano
+  {
+    bool inserted = false;
+    publish(insertInto(this->root, true, inserted, key, std::forward<M>(mapped)));
+    return inserted;
+  }
+
+  template <typename M>
+  bool insert_or_assign(key_type&& key, M&& mapped)
+  {
+    bool inserted = false;
+    publish(insertInto(this->root, true, inserted, std::move(key), std::forward<M>(mapped)));
+    return inserted;
+  }
+
+  void remove(const key_type& key)
+  {
+    NodePtr fresh = removeFrom(this->root, key);
+    if(fresh == this->root)  throw std::out_of_range("Remove is out of range.");
+    publish(std::move(fresh));
+  }
+
+  template <typename K, typename = typename Base::template EnableLookup<K>>
+  void remove(const K& key)
+  {
+    NodePtr fresh = removeFrom(this->root, key);
+    if(fresh == this->root)  throw std::out_of_range("Remove is out of range.");
+    publish(std::move(fresh));
+  }
+
+  void clear() ///węzły zwolni ostatnia wersja, która ich używa
+  {
+    publish(nullptr);
+  }
+};
+
+}
+
+#endif /* AISDI_MAPS_PERSISTENTTREEMAP_H */
@@ -0,0 +1,296 @@
+#ifndef AISDI_MAPS_STATICHASHMAP_H
+#define AISDI_MAPS_STATICHASHMAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "Functional.h"
+
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+
+namespace aisdi
+{
+
+///haszowanie w czasie kompilacji: liczby i wyliczenia przez mix(), napisy przez FNV-1a po znakach.
+///const char*, std::string_view i std::string o tych samych znakach dają ten sam wynik
+struct StaticHash
+{
+  using is_transparent = void;
+
+  template <typename T, typename = typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type>
+  constexpr std::uint64_t operator()(T value) const
+  {
+    return mix(static_cast<std::uint64_t>(value));
+  }
+
+  constexpr std::uint64_t operator()(const char* text) const
+  {
+    std::uint64_t hash = 0xcbf29ce484222325ull;
+    for(; *text != '\0'; ++text)  hash = (hash ^ static_cast<unsigned char>(*text)) * 0x100000001b3ull;
+    return mix(hash);
+  }
+
+  static constexpr std::uint64_t bytes(const char* data, std::size_t size)
+  {
+    std::uint64_t hash = 0xcbf29ce484222325ull;
+    for(std::size_t i = 0; i < size; ++i)  hash = (hash ^ static_cast<unsigned char>(data[i])) * 0x100000001b3ull;
+    return mix(hash);
+  }
+
+#if __cplusplus >= 201703L
+  constexpr std::uint64_t operator()(std::string_view text) const
+  {
+    return bytes(text.data(), text.size());
+  }
+#endif
+
+  std::uint64_t operator()(const std::string& text) const
+  {
+    return bytes(text.data(), text.size());
+  }
+};
+
+///jak EqualTo, ale dwa const char* porównuje po znakach, a nie po adresach
+struct StaticEqual
+{
+  using is_transparent = void;
+
+  template <typename T, typename U>
+  constexpr bool operator()(const T& lhs, const U& rhs) const
+  {
+    return lhs == rhs;
+  }
+
+  constexpr bool operator()(const char* lhs, const char* rhs) const
+  {
+    for(; *lhs != '\0' && *lhs == *rhs; ++lhs, ++rhs) {}
+    return *lhs == *rhs;
+  }
+};
+
+///mapa tylko do odczytu o zbiorze kluczy znanym w czasie kompilacji. Konstruktor constexpr znajduje
+///haszowanie doskonałe metodą hash-and-displace: klucze dzieli na kubełki wg górnych bitów skrótu,
+///a każdemu kubełkowi (od największych) dobiera ziarno, które rozrzuca jego klucze na wolne miejsca.
+///Wyszukiwanie to jeden skrót klucza, jedno mieszanie z ziarnem, jeden indeks i jedno porównanie;
+///wszystko leży w obiekcie, bez sterty. Iteracja w kolejności podania par.
+///Klucze muszą być typami literałowymi (liczby, wyliczenia, const char*, std::string_view)
+template <typename KeyType, typename ValueType, std::size_t N,
+          typename Hasher = StaticHash, typename KeyEqual = StaticEqual>
+class StaticHashMap
+{
+  static_assert(N > 0, "StaticHashMap needs at least one element.");
+
+public:
+  using key_type = KeyType;
+  using mapped_type = ValueType;
+  using value_type = std::pair<key_type, mapped_type>; ///klucz niestały, by tablica dała się zbudować constexpr
+  using size_type = std::size_t;
+  using hasher = Hasher;
+  using key_equal = KeyEqual;
+  using reference = const value_type&;
+  using const_reference = const value_type&;
+  using const_iterator = const value_type*;
+  using iterator = const_iterator;
+
+private:
+  static constexpr size_type roundUp(size_type count)
+  {
+    size_type result = 1;
+    while(result < count)  result *= 2;
+    return result;
+  }
+
+  enum : size_type
+  {
+    TableSize = roundUp(N),      ///potęga dwójki, więc miejsce to maska zamiast modulo
+    BucketCount = N / 2 + 1,     ///średnio dwa klucze na kubełek
+    MaxSeed = 1u << 20           ///górna granica prób na kubełek; po niej budowa się poddaje
+  };
+
+  value_type entries[N];
+  size_type slots[TableSize];        ///indeks w entries albo N dla wolnego miejsca
+  std::uint32_t seeds[BucketCount];
+  hasher hash;
+  key_equal equal;
+
+  template <typename K>
+  using EnableLookup = typename std::enable_if<IsTransparent<hasher>::value && IsTransparent<key_equal>::value
+                                               && !std::is_same<K, key_type>::value>::type;
+
+  static constexpr size_type bucketOf(std::uint64_t hashed) ///górne 32 bity przeskalowane do BucketCount
+  {
+    return static_cast<size_type>(((hashed >> 32) * BucketCount) >> 32);
+  }
+
+  static constexpr size_type slotOf(std::uint64_t hashed, std::uint32_t seed)
+  {
+    return static_cast<size_type>(mix(hashed ^ (seed * 0x9e3779b97f4a7c15ull)) & (TableSize - 1));
+  }
+
+  template <std::size_t... I>
+  constexpr StaticHashMap(const value_type (&items)[N], const hasher& hash, const key_equal& equal,
+                          std::index_sequence<I...>)
+    : entries{ items[I]... }, slots{}, seeds{}, hash(hash), equal(equal)
+  {
+    build();
+  }
+
+  constexpr void build()
+  {
+    std::uint64_t hashes[N] = {};
+    size_type starts[BucketCount + 1] = {}; ///members[starts[b]..starts[b + 1]) to klucze kubełka b
+    size_type members[N] = {};
+
+    for(size_type i = 0; i < N; ++i) {
+      hashes[i] = hash(entries[i].first);
+      ++starts[bucketOf(hashes[i]) + 1];
+    }
+    size_type largest = 0;
+    for(size_type b = 0; b < BucketCount; ++b) {
+      if(starts[b + 1] > largest)  largest = starts[b + 1];
+      starts[b + 1] += starts[b];
+    }
+    size_type filled[BucketCount] = {};
+    for(size_type i = 0; i < N; ++i) {
+      const size_type b = bucketOf(hashes[i]);
+      for(size_type k = starts[b]; k < starts[b] + filled[b]; ++k) { ///równe skróty lądują w tym samym kubełku
+        if(hashes[members[k]] != hashes[i])  continue;
+        if(equal(entries[members[k]].first, entries[i].first))  throw std::invalid_argument("Duplicate key.");
+        throw std::invalid_argument("Keys have the same hash.");
+      }
+      members[starts[b] + filled[b]++] = i;
+    }
+
+    for(size_type s = 0; s < TableSize; ++s)  slots[s] = N;
+    for(size_type count = largest; count > 0; --count)
+      for(size_type b = 0; b < BucketCount; ++b)
+        if(starts[b + 1] - starts[b] == count)  place(hashes, members + starts[b], count, b);
+  }
+
+  ///szuka ziarna, przy którym wszystkie klucze kubełka trafiają na wolne i różne miejsca
+  constexpr void place(const std::uint64_t* hashes, const size_type* members, size_type count, size_type bucket)
+  {
+    for(std::uint32_t seed = 0; seed < MaxSeed; ++seed) {
+      size_type taken = 0;
+      while(taken < count && slots[slotOf(hashes[members[taken]], seed)] == N) {
+        slots[slotOf(hashes[members[taken]], seed)] = members[taken];
+        ++taken;
+      }
+      if(taken == count) {
+        seeds[bucket] = seed;
+        return;
+      }
+      while(taken > 0) {
+        --taken;
+        slots[slotOf(hashes[members[taken]], seed)] = N;
+      }
+    }
+    throw std::runtime_error("Perfect hash not found.");
+  }
+
+  template <typename K>
+  constexpr size_type indexOf(const K& key) const ///N gdy brak
+  {
+    const std::uint64_t hashed = hash(key);
+    const size_type index = slots[slotOf(hashed, seeds[bucketOf(hashed)])];
+    return index != N && equal(entries[index].first, key) ? index : N;
+  }
+
+public:
+  constexpr explicit StaticHashMap(const value_type (&items)[N], const hasher& hash = hasher(),
+                                   const key_equal& equal = key_equal())
+    : StaticHashMap(items, hash, equal, std::make_index_sequence<N>())
+  {}
+
+  constexpr size_type getSize() const
+  {
+    return N;
+  }
+
+  constexpr bool isEmpty() const
+  {
+    return false;
+  }
+
+  constexpr size_type bucket_count() const
+  {
+    return TableSize;
+  }
+
+  constexpr const mapped_type& valueOf(const key_type& key) const
+  {
+    const size_type index = indexOf(key);
+    if(index == N)  throw std::out_of_range("ValueOf is out of range.");
+    return entries[index].second;
+  }
+
+  constexpr const_iterator find(const key_type& key) const
+  {
+    return entries + indexOf(key);
+  }
+
+  constexpr bool contains(const key_type& key) const
+  {
+    return indexOf(key) != N;
+  }
+
+  template <typename K, typename = EnableLookup<K>>
+  constexpr const mapped_type& valueOf(const K& key) const
+  {
+    const size_type index = indexOf(key);
+    if(index == N)  throw std::out_of_range("ValueOf is out of range.");
+    return entries[index].second;
+  }
+
+  template <typename K, typename = EnableLookup<K>>
+  constexpr const_iterator find(const K& key) const
+  {
+    return entries + indexOf(key);
+  }
+
+  template <typename K, typename = EnableLookup<K>>
+  constexpr bool contains(const K& key) const
+  {
+    return indexOf(key) != N;
+  }
+
+  constexpr const_iterator cbegin() const
+  {
+    return entries;
+  }
+
+  constexpr const_iterator cend() const
+  {
+    return entries + N;
+  }
+
+  constexpr const_iterator begin() const
+  {
+    return cbegin();
+  }
+
+  constexpr const_iterator end() const
+  {
+    return cend();
+  }
+};
+
+///typy klucza i wartości podaje się jawnie, rozmiar wynika z listy:
+///constexpr auto ops = makeStaticHashMap<const char*, int>({ { "add", 1 }, { "sub", 2 } });
+template <typename KeyType, typename ValueType, typename Hasher = StaticHash, typename KeyEqual = StaticEqual,
+          std::size_t N>
+constexpr StaticHashMap<KeyType, ValueType, N, Hasher, KeyEqual>
+makeStaticHashMap(const std::pair<KeyType, ValueType> (&items)[N])
+{
+  return StaticHashMap<KeyType, ValueType, N, Hasher, KeyEqual>(items);
+}
+
+}
+
+#endif /* AISDI_MAPS_STATICHASHMAP_H */
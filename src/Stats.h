@@ -0,0 +1,114 @@
+#ifndef AISDI_MAPS_STATS_H
+#define AISDI_MAPS_STATS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+
+///AISDI_MAPS_COUNTERS włącza liczniki w gorących ścieżkach map; bez niego liczniki nie istnieją
+///i nic nie kosztują. Musi być ustawione jednakowo we wszystkich jednostkach kompilacji programu.
+///Liczą także metody const, które wolno wołać z wielu wątków naraz (ConcurrentHashMap robi to pod
+///wspólną blokadą), dlatego liczniki są atomowe (memory_order_relaxed): bez wyścigów, ale też bez
+///porządkowania - odczyt w trakcie pracy innych wątków daje tylko przybliżone wartości.
+#ifdef AISDI_MAPS_COUNTERS
+#define AISDI_MAPS_COUNT(counter) (this->counters.counter.fetch_add(1, std::memory_order_relaxed))
+#define AISDI_MAPS_COUNT_N(counter, n) (this->counters.counter.fetch_add((n), std::memory_order_relaxed))
+#else
+#define AISDI_MAPS_COUNT(counter) ((void)0)
+#define AISDI_MAPS_COUNT_N(counter, n) ((void)0)
+#endif
+
+namespace aisdi
+{
+
+#ifdef AISDI_MAPS_COUNTERS
+constexpr bool counters_enabled = true;
+#else
+constexpr bool counters_enabled = false;
+#endif
+
+struct Counters ///od utworzenia mapy albo reset_counters(); przy wyłączonych licznikach same zera
+{
+  std::uint64_t lookups = 0;       ///wyszukiwania klucza, także te przy wstawianiu
+  std::uint64_t probes = 0;        ///odwiedzone węzły: ogniwa łańcuchów albo węzły na ścieżce w drzewie
+  std::uint64_t comparisons = 0;   ///wywołania key_equal albo compare
+  std::uint64_t allocations = 0;   ///węzłów
+  std::uint64_t deallocations = 0;
+  std::uint64_t rehashes = 0;      ///HashMap: powiększenia tablicy, także rozpoczęte migracje
+  std::uint64_t rotations = 0;     ///TreeMap: rotacje przy równoważeniu
+};
+
+struct AtomicCounters ///to, co mapy trzymają u siebie; na zewnątrz wychodzi kopia jako Counters
+{
+  std::atomic<std::uint64_t> lookups{0};
+  std::atomic<std::uint64_t> probes{0};
+  std::atomic<std::uint64_t> comparisons{0};
+  std::atomic<std::uint64_t> allocations{0};
+  std::atomic<std::uint64_t> deallocations{0};
+  std::atomic<std::uint64_t> rehashes{0};
+  std::atomic<std::uint64_t> rotations{0};
+
+  Counters load() const
+  {
+    Counters result;
+    result.lookups = lookups.load(std::memory_order_relaxed);
+    result.probes = probes.load(std::memory_order_relaxed);
+    result.comparisons = comparisons.load(std::memory_order_relaxed);
+    result.allocations = allocations.load(std::memory_order_relaxed);
+    result.deallocations = deallocations.load(std::memory_order_relaxed);
+    result.rehashes = rehashes.load(std::memory_order_relaxed);
+    result.rotations = rotations.load(std::memory_order_relaxed);
+    return result;
+  }
+
+  void reset()
+  {
+    for(std::atomic<std::uint64_t>* counter : { &lookups, &probes, &comparisons, &allocations,
+                                                &deallocations, &rehashes, &rotations })
+      counter->store(0, std::memory_order_relaxed);
+  }
+};
+
+struct HashMapStats
+{
+  std::size_t size = 0;
+  std::size_t buckets = 0;
+  std::size_t old_buckets = 0;          ///w trakcie migracji: nieprzeniesione kubełki starej tablicy
+  float load_factor = 0;
+  float max_load_factor = 0;
+  std::size_t empty_buckets = 0;
+  std::size_t longest_chain = 0;
+  std::vector<std::size_t> chain_lengths; ///chain_lengths[k] - liczba kubełków z łańcuchem długości k
+  double average_hit_probes = 0;        ///oczekiwana liczba ogniw przejrzanych przy trafieniu
+  std::size_t node_bytes = 0;
+  std::size_t table_bytes = 0;
+  std::size_t bytes = 0;                ///razem z samym obiektem; bez pamięci przydzielanej przez klucze i wartości
+  Counters counters;
+};
+
+struct TreeMapStats
+{
+  std::size_t size = 0;
+  int height = 0;                       ///Node::height korzenia
+  std::size_t max_depth = 0;            ///korzeń ma głębokość 1, więc max_depth == height
+  double average_depth = 0;             ///średnia liczba węzłów na ścieżce do elementu - koszt trafienia
+  std::size_t node_bytes = 0;
+  std::size_t bytes = 0;                ///razem z samym obiektem; bez pamięci przydzielanej przez klucze i wartości
+  Counters counters;
+};
+
+struct CacheStats ///LruHashMap: liczniki zawsze włączone, od utworzenia albo reset_counters()
+{
+  std::size_t size = 0;
+  std::size_t capacity = 0;
+  std::uint64_t hits = 0;               ///find, valueOf i operator[] z kluczem obecnym w pamięci
+  std::uint64_t misses = 0;
+  std::uint64_t evictions = 0;          ///elementy usunięte, by zrobić miejsce
+  double hit_rate = 0;                  ///hits / (hits + misses)
+};
+
+}
+
+#endif /* AISDI_MAPS_STATS_H */
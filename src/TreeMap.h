@@ -1,15 +1,88 @@
 #ifndef AISDI_MAPS_TREEMAP_H
 #define AISDI_MAPS_TREEMAP_H
 
+#include <algorithm>
 #include <cstddef>
 #include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <thread>
+#include <tuple>
 #include <stdexcept>
+#include <type_traits>
 #include <utility>
+#include <vector>
+
+#include "Functional.h"
+#include "FrozenTreeMap.h"
+#include "PersistentTreeMap.h"
+#include "NodePool.h"
+#include "Stats.h"
 
 namespace aisdi
 {
 
-template <typename KeyType, typename ValueType>
+template <typename Iterator>
+class IteratorRange ///para iteratorów [first, last) do użycia w pętli for zakresowej
+{
+public:
+  IteratorRange(Iterator first, Iterator last) : first(first), last(last) {}
+
+  Iterator begin() const
+  {
+    return first;
+  }
+
+  Iterator end() const
+  {
+    return last;
+  }
+
+  bool empty() const
+  {
+    return first == last;
+  }
+
+private:
+  Iterator first;
+  Iterator last;
+};
+
+///stable_sort dzielony na połowy między wątki, połówki scalane inplace_merge; threads <= 1 - zwykły stable_sort
+template <typename RandomIt, typename Compare>
+void parallelStableSort(RandomIt first, RandomIt last, Compare compare, unsigned threads)
+{
+  const std::ptrdiff_t minimal = 1 << 14; ///mniejsze kawałki nie są warte osobnego wątku
+  if(threads <= 1 || last - first < 2 * minimal) {
+    std::stable_sort(first, last, compare);
+    return;
+  }
+  RandomIt middle = first + (last - first) / 2;
+  std::thread worker([=]() { parallelStableSort(first, middle, compare, threads / 2); });
+  parallelStableSort(middle, last, compare, threads - threads / 2);
+  worker.join();
+  std::inplace_merge(first, middle, last, compare);
+}
+
+template <bool Enabled>
+struct SubtreeCount ///liczba węzłów poddrzewa, tylko w drzewie ze statystykami pozycyjnymi
+{
+  std::size_t count = 1;
+  std::size_t getCount() const { return count; }
+  void setCount(std::size_t value) { count = value; }
+};
+
+template <>
+struct SubtreeCount<false> ///pusta baza - bez dodatkowej pamięci w węźle
+{
+  std::size_t getCount() const { return 0; }
+  void setCount(std::size_t) {}
+};
+
+///OrderStatistics = true: węzły pamiętają rozmiar poddrzewa, dostępne rank, select, count_range
+///i skoki iteratorem w O(log n)
+template <typename KeyType, typename ValueType, typename Compare = Less,
+          typename Allocator = std::allocator<std::pair<const KeyType, ValueType>>, bool OrderStatistics = false>
 class TreeMap
 {
 public:
@@ -19,6 +92,8 @@ public:
   using size_type = std::size_t;
   using reference = value_type&;
   using const_reference = const value_type&;
+  using allocator_type = Allocator;
+  using key_compare = Compare;
 
   class ConstIterator;
   class Iterator;
@@ -26,99 +101,379 @@ public:
   using const_iterator = ConstIterator;
 
 protected:
-  struct Node
+  struct Node : SubtreeCount<OrderStatistics>
   {
     value_type value;
     Node *left, *right, *parent;
     int height;
-    Node(key_type key, mapped_type mapped)
-      : value(std::make_pair(key, mapped)), left(nullptr), right(nullptr), parent(nullptr), height(1) {}
-    Node(value_type it) : Node(it.first,it.second) {}
-    ~Node() { delete left; delete right; }
+    template <typename... Args>
+    explicit Node(Args&&... args) ///wartość budowana w miejscu
+      : value(std::forward<Args>(args)...), left(nullptr), right(nullptr), parent(nullptr), height(1) {}
   };
+  using NodeAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<Node>;
+  using NodeTraits = std::allocator_traits<NodeAllocator>;
+
   Node* root;
   size_type size;
+  NodeAllocator alloc;
+  key_compare compare;
+#ifdef AISDI_MAPS_COUNTERS
+  mutable AtomicCounters counters;
+#endif
+
+  template <typename K> ///wyszukiwanie po typie porównywalnym z kluczem, bez tworzenia key_type
+  using EnableLookup = typename std::enable_if<IsTransparent<key_compare>::value
+                                               && !std::is_convertible<const K&, const_iterator>::value>::type;
+
+  template <typename It>
+  using RequireIterator = typename std::iterator_traits<It>::iterator_category;
 
   ///metody pomocnicze
 
+  template <typename... Args>
+  Node* createNode(Args&&... args)
+  {
+    Node* node = NodeTraits::allocate(alloc, 1);
+    try {
+      NodeTraits::construct(alloc, node, std::forward<Args>(args)...);
+    }
+    catch(...) {
+      NodeTraits::deallocate(alloc, node, 1);
+      throw;
+    }
+    AISDI_MAPS_COUNT(allocations);
+    return node;
+  }
+
+  void destroyNode(Node* node)
+  {
+    AISDI_MAPS_COUNT(deallocations);
+    NodeTraits::destroy(alloc, node);
+    NodeTraits::deallocate(alloc, node, 1);
+  }
+
+  void destroyTree(Node* node, bool deallocate) ///post-order po wskaźnikach parent, bez rekurencji
+  {
+    if(node == nullptr) return;
+    Node* stop = node->parent;
+    while(node != stop) {
+      if(node->left != nullptr) node = node->left;
+      else if(node->right != nullptr)  node = node->right;
+      else {
+        Node* parent = node->parent;
+        if(parent != stop) {
+          if(parent->left == node)  parent->left = nullptr;
+          else  parent->right = nullptr;
+        }
+        if(deallocate)  destroyNode(node);
+        else  NodeTraits::destroy(alloc, node);
+        node = parent;
+      }
+    }
+  }
+
   void erase()
   {
-    delete root;
+    bool drop = ArenaTraits<NodeAllocator>::exclusive(alloc); ///cała arena należy do nas - zwalniamy ją w całości
+    if(drop)  AISDI_MAPS_COUNT_N(deallocations, size);
+    if(!drop || !std::is_trivially_destructible<value_type>::value)
+      destroyTree(root, !drop);
+    if(drop)  ArenaTraits<NodeAllocator>::release(alloc);
     root = nullptr;
     size = 0;
   }
 
-  void insert(Node* node)
+  std::pair<Node*, bool> findSlot(const key_type& key) const ///węzeł z kluczem albo jego przyszły rodzic
   {
-    if (root == nullptr) root = node;
+    AISDI_MAPS_COUNT(lookups);
+    Node* temp = root;
+    Node* parent = nullptr;
+    while (temp != nullptr) {
+      parent = temp;
+      AISDI_MAPS_COUNT(probes);
+      AISDI_MAPS_COUNT(comparisons);
+      if (compare(temp->value.first, key))  temp = temp->right;
+      else if ((AISDI_MAPS_COUNT(comparisons), compare(key, temp->value.first))) temp = temp->left;
+      else  return std::make_pair(temp, true);
+    }
+    return std::make_pair(parent, false);
+  }
+
+  void attach(Node* node, Node* parent)
+  {
+    node->parent = parent;
+    if (parent == nullptr) root = node;
     else {
-      Node* temp = root;
-      while (true) {
-        if (node->value.first > temp->value.first) {
-          if (temp->right == nullptr) {
-            temp->right = node;
-            node->parent = temp;
-            break;
-          }
-          else  temp = temp->right;
-        }
-        else if (node->value.first < temp->value.first) {
-          if (temp->left == nullptr) {
-            temp->left = node;
-            node->parent = temp;
-            break;
-          }
-          else  temp = temp->left;
-        }
-        else {
-          delete node;
-          return;
-        }
-      }
+      if (compare(node->value.first, parent->value.first))  parent->left = node;
+      else  parent->right = node;
+      rebalance(parent);
+      updateCounts(parent);
     }
     ++size;
-    return;
+  }
+
+  std::pair<Node*, bool> insert(Node* node) ///jeśli klucz już jest, nowy węzeł jest niszczony
+  {
+    auto slot = findSlot(node->value.first);
+    if (slot.second) {
+      destroyNode(node);
+      return std::make_pair(slot.first, false);
+    }
+    attach(node, slot.first);
+    return std::make_pair(node, true);
+  }
+
+  template <typename K, typename... Args>
+  std::pair<iterator, bool> tryEmplace(K&& key, Args&&... args)
+  {
+    auto slot = findSlot(key);
+    if (slot.second)  return std::make_pair(iterator(this, slot.first), false);
+    Node* node = createNode(std::piecewise_construct, std::forward_as_tuple(std::forward<K>(key)),
+                            std::forward_as_tuple(std::forward<Args>(args)...));
+    attach(node, slot.first);
+    return std::make_pair(iterator(this, node), true);
+  }
+
+  template <typename K, typename M>
+  std::pair<iterator, bool> insertOrAssign(K&& key, M&& mapped)
+  {
+    auto slot = findSlot(key);
+    if (slot.second) {
+      slot.first->value.second = std::forward<M>(mapped);
+      return std::make_pair(iterator(this, slot.first), false);
+    }
+    Node* node = createNode(std::forward<K>(key), std::forward<M>(mapped));
+    attach(node, slot.first);
+    return std::make_pair(iterator(this, node), true);
   }
 
   void remove(Node* node)
   {
+    Node* start = node->parent; ///od tego węzła w górę trzeba przywrócić zrównoważenie
     if (node->left == nullptr)  change(node, node->right); ///jeśli nic nie ma po lewej to wstawiamy prawe poddrzewo
     else if (node->right == nullptr)  change(node, node->left); ///jeśli nie ma nic po prawej to wstawiamy lewe poddrzewo
     else {  ///dwójka dzieci
-      auto temp = node->right;
-      while (temp->left != nullptr) temp = temp->left; ///raz w prawo, do końca w lewo
-      change(temp, temp->right);
+      auto temp = getFirst(node->right); ///raz w prawo, do końca w lewo
+      if (temp->parent != node) {
+        start = temp->parent;
+        change(temp, temp->right);
+        temp->right = node->right;
+        temp->right->parent = temp;
+      }
+      else  start = temp;
       change(node, temp);
+      temp->left = node->left;
+      temp->left->parent = temp;
+      temp->height = node->height;
     }
+    rebalance(start);
+    updateCounts(start);
     --size;
-    delete node;
+    destroyNode(node);
   }
 
-  void change(Node* kono, Node* sono)
+  void change(Node* kono, Node* sono) ///podpina sono w miejsce kono
   {
     if (kono->parent == nullptr)  root = sono;
     else if (kono == kono->parent->left)  kono->parent->left = sono;
     else  kono->parent->right = sono;
 
-    if (sono != nullptr) {
-      sono->parent = kono->parent;
-      if(kono->right != nullptr && kono->right != sono) sono->right = kono->right;
-      if(kono->left != nullptr && kono->left != sono) sono->left = kono->left;
+    if (sono != nullptr)  sono->parent = kono->parent;
+  }
+
+  ///AVL
+
+  static int heightOf(const Node* node)
+  {
+    return node == nullptr ? 0 : node->height;
+  }
+
+  static void updateHeight(Node* node) ///razem z wysokością także licznik poddrzewa
+  {
+    node->height = 1 + std::max(heightOf(node->left), heightOf(node->right));
+    node->setCount(1 + countOf(node->left) + countOf(node->right));
+  }
+
+  ///statystyki pozycyjne
+
+  static size_type countOf(const Node* node)
+  {
+    return node == nullptr ? 0 : node->getCount();
+  }
+
+  static void updateCounts(Node* node) ///rebalance kończy się wcześnie, liczniki trzeba poprawić aż do korzenia
+  {
+    if (!OrderStatistics)  return;
+    for (; node != nullptr; node = node->parent)
+      node->setCount(1 + countOf(node->left) + countOf(node->right));
+  }
+
+  template <typename K>
+  size_type rankOf(const K& key) const ///liczba kluczy < key
+  {
+    size_type result = 0;
+    Node* node = root;
+    while (node != nullptr) {
+      if (compare(node->value.first, key)) {
+        result += countOf(node->left) + 1;
+        node = node->right;
+      }
+      else  node = node->left;
+    }
+    return result;
+  }
+
+  ///first i last z lower_bound(low) i lower_bound(high); gdy low > high, last wypada przed first i zakres
+  ///byłby niepoprawny - wtedy pusty, jak w count_range. Porównuje klucze z drzewa, więc działa też dla
+  ///typów wyszukiwania, których nie da się porównać między sobą
+  template <typename It>
+  IteratorRange<It> boundedRange(It first, It last) const
+  {
+    if (last != cend() && (first == cend() || compare(last->first, first->first)))  last = first;
+    return IteratorRange<It>(first, last);
+  }
+
+  Node* selectNode(size_type index) const ///węzeł na pozycji index, nullptr dla index >= size
+  {
+    Node* node = root;
+    while (node != nullptr) {
+      size_type left = countOf(node->left);
+      if (index < left)  node = node->left;
+      else if (index == left)  break;
+      else {
+        index -= left + 1;
+        node = node->right;
+      }
+    }
+    return node;
+  }
+
+  size_type positionOf(const Node* node) const ///nullptr (end) ma pozycję size
+  {
+    if (node == nullptr)  return size;
+    size_type result = countOf(node->left);
+    for (; node->parent != nullptr; node = node->parent)
+      if (node == node->parent->right)  result += countOf(node->parent->left) + 1;
+    return result;
+  }
+
+  Node* rotateLeft(Node* node)
+  {
+    AISDI_MAPS_COUNT(rotations);
+    Node* pivot = node->right;
+    change(node, pivot);
+    node->right = pivot->left;
+    if (node->right != nullptr) node->right->parent = node;
+    pivot->left = node;
+    node->parent = pivot;
+    updateHeight(node);
+    updateHeight(pivot);
+    return pivot;
+  }
+
+  Node* rotateRight(Node* node)
+  {
+    AISDI_MAPS_COUNT(rotations);
+    Node* pivot = node->left;
+    change(node, pivot);
+    node->left = pivot->right;
+    if (node->left != nullptr) node->left->parent = node;
+    pivot->right = node;
+    node->parent = pivot;
+    updateHeight(node);
+    updateHeight(pivot);
+    return pivot;
+  }
+
+  Node* balance(Node* node) ///zwraca nowy korzeń poddrzewa
+  {
+    updateHeight(node);
+    int factor = heightOf(node->left) - heightOf(node->right);
+    if (factor > 1) {
+      if (heightOf(node->left->left) < heightOf(node->left->right))  rotateLeft(node->left);
+      node = rotateRight(node);
+    }
+    else if (factor < -1) {
+      if (heightOf(node->right->right) < heightOf(node->right->left))  rotateRight(node->right);
+      node = rotateLeft(node);
+    }
+    return node;
+  }
+
+  void rebalance(Node* node) ///idziemy w górę dopóki zmienia się wysokość
+  {
+    while (node != nullptr) {
+      int height = node->height;
+      node = balance(node);
+      if (node->height == height) break;
+      node = node->parent;
     }
-    kono->parent = kono->left   = kono->right  = nullptr;
   }
 
-  Node* getNode(const key_type& key) const
+  template <typename K>
+  Node* getNode(const K& key) const
   {
+    AISDI_MAPS_COUNT(lookups);
     Node* node = root;
     while (node != nullptr) {
-      if (key > node->value.first)  node = node->right;
-      else if (key < node->value.first) node = node->left;
+      AISDI_MAPS_COUNT(probes);
+      AISDI_MAPS_COUNT(comparisons);
+      if (compare(node->value.first, key))  node = node->right;
+      else if ((AISDI_MAPS_COUNT(comparisons), compare(key, node->value.first))) node = node->left;
       else  break;
     }
     return node;
   }
 
+  enum { BatchGroup = 16 }; ///tyle ścieżek od korzenia jest przechodzonych na przemian
+
+  ///wyszukiwanie na przemian (AMAC): każde wyszukiwanie robi jeden krok w dół i zleca prefetch następnego
+  ///węzła, zanim wróci do niego kolejka - zamiast log n zależnych chybień po kolei, do BatchGroup naraz;
+  ///zakończone wyszukiwanie od razu zwalnia miejsce następnemu kluczowi
+  template <typename Visit>
+  void probeBatch(const key_type* keys, size_type count, Visit visit) const
+  {
+    AISDI_MAPS_COUNT_N(lookups, count);
+    if(root == nullptr) {
+      for(size_type i = 0; i < count; ++i)  visit(i, nullptr);
+      return;
+    }
+    Node *nodes[BatchGroup];
+    size_type lanes[BatchGroup];
+    size_type next = 0, active = 0;
+    for(; active < BatchGroup && next < count; ++active, ++next) {
+      nodes[active] = root;
+      lanes[active] = next;
+    }
+    while(active > 0) {
+      for(size_type i = 0; i < active; ) {
+        Node* node = nodes[i];
+        const key_type& key = keys[lanes[i]];
+        bool found = false;
+        AISDI_MAPS_COUNT(probes);
+        AISDI_MAPS_COUNT(comparisons);
+        if(compare(node->value.first, key))  node = node->right;
+        else if((AISDI_MAPS_COUNT(comparisons), compare(key, node->value.first)))  node = node->left;
+        else  found = true;
+        if(!found && node != nullptr) {
+          prefetch(node);
+          nodes[i++] = node;
+          continue;
+        }
+        visit(lanes[i], node);
+        if(next < count) {
+          nodes[i] = root;
+          lanes[i++] = next++;
+        }
+        else { ///ostatnia aktywna ścieżka na zwolnione miejsce, sprawdzana jeszcze w tym obiegu
+          --active;
+          nodes[i] = nodes[active];
+          lanes[i] = lanes[active];
+        }
+      }
+    }
+  }
+
   Node* getFirst(Node* node) const
   {
     if(node != nullptr)
@@ -127,16 +482,270 @@ protected:
     return node;
   }
 
+  template <typename K>
+  Node* lowerBound(const K& key) const ///pierwszy węzeł z kluczem >= key
+  {
+    AISDI_MAPS_COUNT(lookups);
+    Node* node = root;
+    Node* result = nullptr;
+    while (node != nullptr) {
+      AISDI_MAPS_COUNT(probes);
+      AISDI_MAPS_COUNT(comparisons);
+      if (compare(node->value.first, key))  node = node->right;
+      else {
+        result = node;
+        node = node->left;
+      }
+    }
+    return result;
+  }
+
+  template <typename K>
+  Node* upperBound(const K& key) const ///pierwszy węzeł z kluczem > key
+  {
+    AISDI_MAPS_COUNT(lookups);
+    Node* node = root;
+    Node* result = nullptr;
+    while (node != nullptr) {
+      AISDI_MAPS_COUNT(probes);
+      AISDI_MAPS_COUNT(comparisons);
+      if (compare(key, node->value.first)) {
+        result = node;
+        node = node->left;
+      }
+      else  node = node->right;
+    }
+    return result;
+  }
+
+  Node* cloneTree(const Node* source) ///ten sam kształt i wysokości, bez porównań; iteracyjnie po wskaźnikach parent
+  {
+    if(source == nullptr)  return nullptr;
+    Node* result = createNode(source->value);
+    result->height = source->height;
+    result->setCount(source->getCount());
+    Node* copy = result;
+    try {
+      while(true) {
+        if(source->left != nullptr && copy->left == nullptr) {
+          copy->left = createNode(source->left->value);
+          copy->left->parent = copy;
+          source = source->left;
+          copy = copy->left;
+        }
+        else if(source->right != nullptr && copy->right == nullptr) {
+          copy->right = createNode(source->right->value);
+          copy->right->parent = copy;
+          source = source->right;
+          copy = copy->right;
+        }
+        else if(copy == result)  break;
+        else {
+          source = source->parent;
+          copy = copy->parent;
+          continue;
+        }
+        copy->height = source->height;
+        copy->setCount(source->getCount());
+      }
+    }
+    catch(...) {
+      destroyTree(result, true);
+      throw;
+    }
+    return result;
+  }
+
+  template <typename It>
+  size_type countSorted(It first, It last) const ///liczba różnych kluczy; wejście musi być niemalejące
+  {
+    if(first == last)  return 0;
+    size_type count = 1;
+    for(It prev = first++; first != last; prev = first++) {
+      if(compare(first->first, prev->first))  throw std::invalid_argument("Input is not sorted.");
+      if(compare(prev->first, first->first))  ++count;
+    }
+    return count;
+  }
+
+  ///drzewo idealnie zrównoważone z count kolejnych różnych kluczy, in-order w O(n);
+  ///z powtórzeń klucza zostaje pierwsze, rekurencja ma głębokość log n
+  template <typename It>
+  Node* buildBalanced(It& it, It last, size_type count)
+  {
+    if(count == 0)  return nullptr;
+    Node* left = buildBalanced(it, last, count / 2);
+    Node* node;
+    try {
+      node = createNode(*it);
+    }
+    catch(...) {
+      destroyTree(left, true);
+      throw;
+    }
+    for(++it; it != last && !compare(node->value.first, it->first); ++it) {}
+    node->left = left;
+    if(left != nullptr)  left->parent = node;
+    try {
+      node->right = buildBalanced(it, last, count - count / 2 - 1);
+    }
+    catch(...) {
+      destroyTree(node, true);
+      throw;
+    }
+    if(node->right != nullptr)  node->right->parent = node;
+    updateHeight(node);
+    return node;
+  }
+
+  template <typename It>
+  void assignSorted(It first, It last, size_type count)
+  {
+    erase();
+    ArenaTraits<NodeAllocator>::reserve(alloc, count);
+    root = buildBalanced(first, last, count);
+    size = count;
+  }
+
+  template <typename It>
+  void assignUnsorted(It first, It last, unsigned threads)
+  {
+    std::vector<std::pair<key_type, mapped_type>> items(first, last);
+    auto less = [this](const std::pair<key_type, mapped_type>& lhs, const std::pair<key_type, mapped_type>& rhs) {
+      return compare(lhs.first, rhs.first);
+    };
+    if(!std::is_sorted(items.begin(), items.end(), less))
+      parallelStableSort(items.begin(), items.end(), less, threads);
+    assignSorted(std::make_move_iterator(items.begin()), std::make_move_iterator(items.end()),
+                 countSorted(items.begin(), items.end()));
+  }
+
+  ///split/join na odłączonych poddrzewach (parent == nullptr); root służy wtedy tylko jako brudnopis dla change()
+
+  static Node* detach(Node* node)
+  {
+    if (node != nullptr)  node->parent = nullptr;
+    return node;
+  }
+
+  Node* rebalanceToTop(Node* node) ///równoważy całą ścieżkę do korzenia poddrzewa i zwraca ten korzeń
+  {
+    while (true) {
+      node = balance(node);
+      if (node->parent == nullptr)  return node;
+      node = node->parent;
+    }
+  }
+
+  Node* join(Node* left, Node* middle, Node* right) ///klucze: left < middle < right; O(|h(left) - h(right)|)
+  {
+    middle->parent = nullptr;
+    if (heightOf(left) > heightOf(right) + 1) { ///middle schodzi prawym brzegiem wyższego drzewa
+      Node* node = left;
+      while (heightOf(node->right) > heightOf(right) + 1)  node = node->right;
+      middle->left = detach(node->right);
+      if (middle->left != nullptr)  middle->left->parent = middle;
+      middle->right = right;
+      if (right != nullptr)  right->parent = middle;
+      updateHeight(middle);
+      node->right = middle;
+      middle->parent = node;
+      return rebalanceToTop(node);
+    }
+    if (heightOf(right) > heightOf(left) + 1) {
+      Node* node = right;
+      while (heightOf(node->left) > heightOf(left) + 1)  node = node->left;
+      middle->right = detach(node->left);
+      if (middle->right != nullptr)  middle->right->parent = middle;
+      middle->left = left;
+      if (left != nullptr)  left->parent = middle;
+      updateHeight(middle);
+      node->left = middle;
+      middle->parent = node;
+      return rebalanceToTop(node);
+    }
+    middle->left = left;
+    middle->right = right;
+    if (left != nullptr)  left->parent = middle;
+    if (right != nullptr)  right->parent = middle;
+    updateHeight(middle);
+    return middle;
+  }
+
+  Node* join(Node* left, Node* right) ///najmniejszy węzeł right staje się środkiem
+  {
+    if (left == nullptr)  return right;
+    if (right == nullptr)  return left;
+    Node* middle = getFirst(right);
+    Node* parent = middle->parent;
+    if (parent == nullptr)  right = detach(middle->right);
+    else {
+      parent->left = middle->right;
+      if (middle->right != nullptr)  middle->right->parent = parent;
+      right = rebalanceToTop(parent);
+    }
+    middle->right = nullptr;
+    return join(left, middle, right);
+  }
+
+  ///dzieli odłączone poddrzewo na klucze < key i >= key; rekurencja tylko wzdłuż jednej ścieżki, O(log n)
+  template <typename K>
+  std::pair<Node*, Node*> split(Node* node, const K& key)
+  {
+    if (node == nullptr)  return std::make_pair(nullptr, nullptr);
+    Node* left = detach(node->left);
+    Node* right = detach(node->right);
+    node->left = node->right = nullptr;
+    if (compare(node->value.first, key)) {
+      auto parts = split(right, key);
+      return std::make_pair(join(left, node, parts.first), parts.second);
+    }
+    auto parts = split(left, key);
+    return std::make_pair(parts.first, join(parts.second, node, right));
+  }
+
 public:
-  TreeMap() : root(nullptr), size(0) {}
+  TreeMap() : TreeMap(Compare()) {}
+
+  explicit TreeMap(const Compare& compare, const Allocator& allocator = Allocator())
+    : root(nullptr), size(0), alloc(allocator), compare(compare) {}
+
+  explicit TreeMap(const Allocator& allocator) : TreeMap(Compare(), allocator) {}
 
   TreeMap(std::initializer_list<value_type> list) : TreeMap()
   {
-    for (auto it = list.begin(); it != list.end(); ++it)
-      insert(new Node(*it));
+    assignUnsorted(list.begin(), list.end(), 1);
+  }
+
+  ///dowolna kolejność: sortowanie stabilne, potem budowa w O(n); przy powtórzeniach klucza wygrywa pierwszy
+  template <typename It, typename = RequireIterator<It>>
+  TreeMap(It first, It last, const Compare& compare = Compare(), const Allocator& allocator = Allocator())
+    : TreeMap(compare, allocator)
+  {
+    assignUnsorted(first, last, 1);
   }
 
-  TreeMap(const TreeMap& other) : TreeMap() ///konstruktor kopiujący
+  template <typename It, typename = RequireIterator<It>>
+  static TreeMap from_unsorted(It first, It last, unsigned threads = std::thread::hardware_concurrency(),
+                               const Compare& compare = Compare(), const Allocator& allocator = Allocator())
+  {
+    TreeMap result(compare, allocator);
+    result.assignUnsorted(first, last, threads);
+    return result;
+  }
+
+  ///wejście posortowane niemalejąco (inaczej invalid_argument), iteratory co najmniej forward; O(n) bez porównań drzewa
+  template <typename It, typename = RequireIterator<It>>
+  static TreeMap from_sorted(It first, It last, const Compare& compare = Compare(),
+                             const Allocator& allocator = Allocator())
+  {
+    TreeMap result(compare, allocator);
+    result.assignSorted(first, last, result.countSorted(first, last));
+    return result;
+  }
+
+  TreeMap(const TreeMap& other) ///konstruktor kopiujący
+    : TreeMap(other.compare, Allocator(NodeTraits::select_on_container_copy_construction(other.alloc)))
   {
     *this = other;
   }
@@ -155,8 +764,10 @@ public:
   {
     if(this != &other) {
         erase();
-        for (auto it = other.begin(); it != other.end(); ++it)
-          insert(new Node(*it));
+        compare = other.compare;
+        ArenaTraits<NodeAllocator>::reserve(alloc, other.size);
+        root = cloneTree(other.root);
+        size = other.size;
     }
     return *this;
   }
@@ -168,6 +779,8 @@ public:
 
       root = other.root;
       size = other.size;
+      std::swap(alloc, other.alloc);
+      std::swap(compare, other.compare);
 
       other.root = nullptr;
       other.size = 0;
@@ -182,12 +795,43 @@ public:
 
   mapped_type& operator[](const key_type& key)
   {
-    Node* temp = getNode(key);
-    if( temp == nullptr ) {
-      temp = new Node(key, mapped_type());
-      insert(temp);
-    }
-    return temp->value.second;
+    return tryEmplace(key).first->second;
+  }
+
+  mapped_type& operator[](key_type&& key)
+  {
+    return tryEmplace(std::move(key)).first->second;
+  }
+
+  template <typename... Args>
+  std::pair<iterator, bool> emplace(Args&&... args)
+  {
+    auto result = insert(createNode(std::forward<Args>(args)...));
+    return std::make_pair(iterator(this, result.first), result.second);
+  }
+
+  template <typename... Args>
+  std::pair<iterator, bool> try_emplace(const key_type& key, Args&&... args)
+  {
+    return tryEmplace(key, std::forward<Args>(args)...);
+  }
+
+  template <typename... Args>
+  std::pair<iterator, bool> try_emplace(key_type&& key, Args&&... args)
+  {
+    return tryEmplace(std::move(key), std::forward<Args>(args)...);
+  }
+
+  template <typename M>
+  std::pair<iterator, bool> insert_or_assign(const key_type& key, M&& mapped)
+  {
+    return insertOrAssign(key, std::forward<M>(mapped));
+  }
+
+  template <typename M>
+  std::pair<iterator, bool> insert_or_assign(key_type&& key, M&& mapped)
+  {
+    return insertOrAssign(std::move(key), std::forward<M>(mapped));
   }
 
   const mapped_type& valueOf(const key_type& key) const
@@ -219,17 +863,270 @@ public:
     remove(find(key));
   }
 
+  template <typename K, typename = EnableLookup<K>>
+  const mapped_type& valueOf(const K& key) const
+  {
+    const Node* temp = getNode(key);
+    if(temp == nullptr)  throw std::out_of_range("ValueOf is out of range.");
+    return temp->value.second;
+  }
+
+  template <typename K, typename = EnableLookup<K>>
+  mapped_type& valueOf(const K& key)
+  {
+    Node* temp = getNode(key);
+    if(temp == nullptr)  throw std::out_of_range("ValueOf is out of range.");
+    return temp->value.second;
+  }
+
+  template <typename K, typename = EnableLookup<K>>
+  const_iterator find(const K& key) const
+  {
+    return const_iterator(this, getNode(key));
+  }
+
+  template <typename K, typename = EnableLookup<K>>
+  iterator find(const K& key)
+  {
+    return iterator(this, getNode(key));
+  }
+
+  template <typename K, typename = EnableLookup<K>>
+  void remove(const K& key)
+  {
+    remove(find(key));
+  }
+
+  ///results[i] = find(keys[i]); opłaca się dla paczek od kilkudziesięciu kluczy wzwyż
+  void find_batch(const key_type* keys, size_type count, const_iterator* results) const
+  {
+    probeBatch(keys, count, [&](size_type i, Node* node) { results[i] = const_iterator(this, node); });
+  }
+
+  void find_batch(const key_type* keys, size_type count, iterator* results)
+  {
+    probeBatch(keys, count, [&](size_type i, Node* node) { results[i] = iterator(this, node); });
+  }
+
+  void contains_batch(const key_type* keys, size_type count, bool* results) const
+  {
+    probeBatch(keys, count, [&](size_type i, Node* node) { results[i] = node != nullptr; });
+  }
+
   void remove(const const_iterator& it)
   {
     if(this != it.tree || it == end())  throw std::out_of_range ("Remove is out of range.");
     remove(it.pointee);
   }
 
+  ///usuwa [first, last): drzewo dzielone na części przed, w i za zakresem, środek niszczony,
+  ///brzegi sklejane - O(k + log n) zamiast k razy remove z równoważeniem
+  iterator erase(const const_iterator& first, const const_iterator& last)
+  {
+    if(this != first.tree || this != last.tree)  throw std::out_of_range("Erase is out of range.");
+    if(first == last)  return iterator(last);
+
+    size_type count = 0;
+    for(auto it = first; it != last; ++it)  ++count;
+
+    auto head = split(root, first.pointee->value.first);
+    auto tail = last.pointee == nullptr ? std::make_pair(head.second, static_cast<Node*>(nullptr))
+                                        : split(head.second, last.pointee->value.first);
+    destroyTree(tail.first, true);
+    root = join(head.first, tail.second);
+    if(root != nullptr)  root->parent = nullptr;
+    size -= count;
+    return iterator(last);
+  }
+
+  const_iterator lower_bound(const key_type& key) const
+  {
+    return const_iterator(this, lowerBound(key));
+  }
+
+  iterator lower_bound(const key_type& key)
+  {
+    return iterator(this, lowerBound(key));
+  }
+
+  const_iterator upper_bound(const key_type& key) const
+  {
+    return const_iterator(this, upperBound(key));
+  }
+
+  iterator upper_bound(const key_type& key)
+  {
+    return iterator(this, upperBound(key));
+  }
+
+  std::pair<const_iterator, const_iterator> equal_range(const key_type& key) const
+  {
+    return std::make_pair(lower_bound(key), upper_bound(key));
+  }
+
+  std::pair<iterator, iterator> equal_range(const key_type& key)
+  {
+    return std::make_pair(lower_bound(key), upper_bound(key));
+  }
+
+  IteratorRange<const_iterator> range(const key_type& low, const key_type& high) const ///klucze z [low, high); pusty, gdy low >= high
+  {
+    return boundedRange<const_iterator>(lower_bound(low), lower_bound(high));
+  }
+
+  IteratorRange<iterator> range(const key_type& low, const key_type& high)
+  {
+    return boundedRange<iterator>(lower_bound(low), lower_bound(high));
+  }
+
+  template <typename K, typename = EnableLookup<K>>
+  const_iterator lower_bound(const K& key) const
+  {
+    return const_iterator(this, lowerBound(key));
+  }
+
+  template <typename K, typename = EnableLookup<K>>
+  iterator lower_bound(const K& key)
+  {
+    return iterator(this, lowerBound(key));
+  }
+
+  template <typename K, typename = EnableLookup<K>>
+  const_iterator upper_bound(const K& key) const
+  {
+    return const_iterator(this, upperBound(key));
+  }
+
+  template <typename K, typename = EnableLookup<K>>
+  iterator upper_bound(const K& key)
+  {
+    return iterator(this, upperBound(key));
+  }
+
+  template <typename K, typename = EnableLookup<K>>
+  std::pair<const_iterator, const_iterator> equal_range(const K& key) const
+  {
+    return std::make_pair(lower_bound(key), upper_bound(key));
+  }
+
+  template <typename K, typename = EnableLookup<K>>
+  std::pair<iterator, iterator> equal_range(const K& key)
+  {
+    return std::make_pair(lower_bound(key), upper_bound(key));
+  }
+
+  template <typename K, typename = EnableLookup<K>>
+  IteratorRange<const_iterator> range(const K& low, const K& high) const
+  {
+    return boundedRange<const_iterator>(lower_bound(low), lower_bound(high));
+  }
+
+  template <typename K, typename = EnableLookup<K>>
+  IteratorRange<iterator> range(const K& low, const K& high)
+  {
+    return boundedRange<iterator>(lower_bound(low), lower_bound(high));
+  }
+
   size_type getSize() const
   {
     return size;
   }
 
+  ///niezmienna kopia w układzie Eytzingera - szybsze wyszukiwania dla danych, które już się nie zmieniają
+  FrozenTreeMap<KeyType, ValueType, Compare> freeze() const
+  {
+    return FrozenTreeMap<KeyType, ValueType, Compare>(cbegin(), cend(), compare);
+  }
+
+  ///wersjonowana kopia z kopiowaniem ścieżki - zbudowana w O(n) z posortowanych elementów
+  PersistentTreeMap<KeyType, ValueType, Compare> persistent() const
+  {
+    return PersistentTreeMap<KeyType, ValueType, Compare>(cbegin(), cend(), compare);
+  }
+
+  TreeMapStats stats() const ///przegląda całe drzewo - O(size), nie do gorącej ścieżki
+  {
+    TreeMapStats result;
+    result.size = size;
+    result.height = heightOf(root);
+    double depths = 0;
+    std::vector<std::pair<const Node*, size_type>> stack; ///wysokość AVL ogranicza głębokość stosu
+    if(root != nullptr)  stack.emplace_back(root, 1);
+    while(!stack.empty()) {
+      const Node* node = stack.back().first;
+      size_type depth = stack.back().second;
+      stack.pop_back();
+      depths += depth;
+      if(depth > result.max_depth)  result.max_depth = depth;
+      if(node->left != nullptr)  stack.emplace_back(node->left, depth + 1);
+      if(node->right != nullptr)  stack.emplace_back(node->right, depth + 1);
+    }
+    result.average_depth = size ? depths / size : 0;
+    result.node_bytes = size * sizeof(Node);
+    result.bytes = sizeof(*this) + result.node_bytes;
+#ifdef AISDI_MAPS_COUNTERS
+    result.counters = counters.load();
+#endif
+    return result;
+  }
+
+  void reset_counters() ///bez AISDI_MAPS_COUNTERS nic nie robi
+  {
+#ifdef AISDI_MAPS_COUNTERS
+    counters.reset();
+#endif
+  }
+
+  size_type rank(const key_type& key) const ///liczba kluczy mniejszych od key
+  {
+    static_assert(OrderStatistics, "rank requires TreeMap with OrderStatistics = true");
+    return rankOf(key);
+  }
+
+  const_iterator select(size_type index) const ///index-ty najmniejszy klucz (od 0), end() gdy index >= getSize()
+  {
+    static_assert(OrderStatistics, "select requires TreeMap with OrderStatistics = true");
+    return const_iterator(this, selectNode(index));
+  }
+
+  iterator select(size_type index)
+  {
+    static_assert(OrderStatistics, "select requires TreeMap with OrderStatistics = true");
+    return iterator(this, selectNode(index));
+  }
+
+  size_type count_range(const key_type& low, const key_type& high) const ///liczba kluczy z [low, high)
+  {
+    static_assert(OrderStatistics, "count_range requires TreeMap with OrderStatistics = true");
+    if (!compare(low, high))  return 0;
+    return rankOf(high) - rankOf(low);
+  }
+
+  template <typename K, typename = EnableLookup<K>>
+  size_type rank(const K& key) const
+  {
+    static_assert(OrderStatistics, "rank requires TreeMap with OrderStatistics = true");
+    return rankOf(key);
+  }
+
+  template <typename K, typename = EnableLookup<K>>
+  size_type count_range(const K& low, const K& high) const
+  {
+    static_assert(OrderStatistics, "count_range requires TreeMap with OrderStatistics = true");
+    if (!compare(low, high))  return 0;
+    return rankOf(high) - rankOf(low);
+  }
+
+  key_compare key_comp() const
+  {
+    return compare;
+  }
+
+  allocator_type get_allocator() const
+  {
+    return allocator_type(alloc);
+  }
+
   bool operator==(const TreeMap& other) const
   {
     if(size != other.size)  return false;
@@ -275,20 +1172,21 @@ public:
   }
 };
 
-template <typename KeyType, typename ValueType> ///operatory do poprawy
-class TreeMap<KeyType, ValueType>::ConstIterator
+template <typename KeyType, typename ValueType, typename Compare, typename Allocator, bool OrderStatistics> ///operatory do poprawy
+class TreeMap<KeyType, ValueType, Compare, Allocator, OrderStatistics>::ConstIterator
 {
 public:
   using reference = typename TreeMap::const_reference;
   using iterator_category = std::bidirectional_iterator_tag;
   using value_type = typename TreeMap::value_type;
+  using difference_type = std::ptrdiff_t;
 
   using pointer = const typename TreeMap::value_type*;
 
 protected:
   const TreeMap *tree;
   Node *pointee;
-  friend void TreeMap<KeyType, ValueType>::remove(const const_iterator&);
+  friend class TreeMap<KeyType, ValueType, Compare, Allocator, OrderStatistics>;
 
 public:
   explicit ConstIterator(const TreeMap *tree = nullptr, Node *pointee = nullptr)
@@ -297,6 +1195,8 @@ public:
   ConstIterator(const ConstIterator& other)
   : ConstIterator(other.tree, other.pointee) {}
 
+  ConstIterator& operator=(const ConstIterator&) = default;
+
   ConstIterator& operator++()
   {
     if(pointee == nullptr || tree == nullptr) {
@@ -367,6 +1267,44 @@ public:
     return result;
   }
 
+  ConstIterator& operator+=(difference_type offset) ///O(log n), tylko z OrderStatistics
+  {
+    static_assert(OrderStatistics, "operator+= requires TreeMap with OrderStatistics = true");
+    if(tree == nullptr)  throw std::out_of_range("Operator+= is out of range.");
+    difference_type target = static_cast<difference_type>(tree->positionOf(pointee)) + offset;
+    if(target < 0 || target > static_cast<difference_type>(tree->size))
+      throw std::out_of_range("Operator+= is out of range.");
+    pointee = tree->selectNode(static_cast<size_type>(target));
+    return *this;
+  }
+
+  ConstIterator& operator-=(difference_type offset)
+  {
+    return ConstIterator::operator+=(-offset);
+  }
+
+  ConstIterator operator+(difference_type offset) const
+  {
+    auto result = *this;
+    result.ConstIterator::operator+=(offset);
+    return result;
+  }
+
+  ConstIterator operator-(difference_type offset) const
+  {
+    auto result = *this;
+    result.ConstIterator::operator+=(-offset);
+    return result;
+  }
+
+  difference_type operator-(const ConstIterator& other) const ///odległość w O(log n)
+  {
+    static_assert(OrderStatistics, "operator- requires TreeMap with OrderStatistics = true");
+    if(tree == nullptr || tree != other.tree)  throw std::out_of_range("Operator- is out of range.");
+    return static_cast<difference_type>(tree->positionOf(pointee))
+           - static_cast<difference_type>(tree->positionOf(other.pointee));
+  }
+
   reference operator*() const
   {
     if(pointee == nullptr || tree == nullptr)  throw std::out_of_range("Operator* is out of range.");
@@ -389,8 +1327,9 @@ public:
   }
 };
 
-template <typename KeyType, typename ValueType>
-class TreeMap<KeyType, ValueType>::Iterator : public TreeMap<KeyType, ValueType>::ConstIterator ///zrobione
+template <typename KeyType, typename ValueType, typename Compare, typename Allocator, bool OrderStatistics>
+class TreeMap<KeyType, ValueType, Compare, Allocator, OrderStatistics>::Iterator
+  : public TreeMap<KeyType, ValueType, Compare, Allocator, OrderStatistics>::ConstIterator ///zrobione
 {
 public:
   using reference = typename TreeMap::reference;
@@ -428,6 +1367,34 @@ public:
     return result;
   }
 
+  Iterator& operator+=(typename ConstIterator::difference_type offset)
+  {
+    ConstIterator::operator+=(offset);
+    return *this;
+  }
+
+  Iterator& operator-=(typename ConstIterator::difference_type offset)
+  {
+    ConstIterator::operator+=(-offset);
+    return *this;
+  }
+
+  Iterator operator+(typename ConstIterator::difference_type offset) const
+  {
+    auto result = *this;
+    result += offset;
+    return result;
+  }
+
+  Iterator operator-(typename ConstIterator::difference_type offset) const
+  {
+    auto result = *this;
+    result -= offset;
+    return result;
+  }
+
+  using ConstIterator::operator-;
+
   pointer operator->() const
   {
     return &this->operator*();
@@ -1,90 +1,766 @@
 #include <cstddef>
+#include <cstdint>
+#include <cstdio>
 #include <cstdlib>
 #include <string>
 
 #include <iostream>
-#include <chrono>
-#include <ctime>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+
+#include <atomic>
+#include <mutex>
+#include <thread>
 
 #include <algorithm>
 #include <vector>
 #include <random>
 
+#include <unistd.h>
+
 #include "TreeMap.h"
+#include "FrozenTreeMap.h"
+#include "PersistentTreeMap.h"
+#include "BTreeMap.h"
 #include "HashMap.h"
+#include "LruHashMap.h"
+#include "FlatHashMap.h"
+#include "ConcurrentHashMap.h"
+#include "ConcurrentSkipListMap.h"
+#include "StaticHashMap.h"
+#include "MappedMap.h"
+#include "Benchmark.h"
 
 namespace
 {
 
+using namespace aisdi::bench;
+
 template <typename K, typename V>
 using TreeMap = aisdi::TreeMap<K, V>;
 template <typename K, typename V>
+using BTreeMap = aisdi::BTreeMap<K, V>;
+template <typename K, typename V>
 using HashMap = aisdi::HashMap<K, V>;
+template <typename K, typename V>
+using FlatHashMap = aisdi::FlatHashMap<K, V>;
+template <typename K, typename V>
+using PoolTreeMap = aisdi::TreeMap<K, V, aisdi::Less, aisdi::PoolAllocator<std::pair<const K, V>>>;
+template <typename K, typename V>
+using PoolHashMap = aisdi::HashMap<K, V, aisdi::Hash<K>, aisdi::EqualTo, aisdi::PoolAllocator<std::pair<const K, V>>>;
+
+template <typename K, typename V>
+class IncrementalHashMap : public HashMap<K, V> ///powiększanie rozłożone na kolejne zmiany mapy
+{
+public:
+  IncrementalHashMap() { this->migration_step(64); }
+};
+
+template <typename Map>
+class LockedMap ///punkt odniesienia: zwykła mapa za jednym globalnym muteksem
+{
+public:
+  using key_type = typename Map::key_type;
+  using mapped_type = typename Map::mapped_type;
+
+  template <typename M>
+  bool insert_or_assign(const key_type& key, M&& mapped)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    return map.insert_or_assign(key, std::forward<M>(mapped)).second;
+  }
+
+  bool find(const key_type& key, mapped_type& out) const
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = map.find(key);
+    if (it == map.end()) return false;
+    out = it->second;
+    return true;
+  }
+
+  std::size_t erase(const key_type& key)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = map.find(key);
+    if (it == map.end()) return 0;
+    map.remove(it);
+    return 1;
+  }
+
+private:
+  mutable std::mutex mutex;
+  Map map;
+};
+
+template <typename K, typename V>
+using LockedHashMap = LockedMap<HashMap<K, V>>;
+template <typename K, typename V>
+using LockedTreeMap = LockedMap<TreeMap<K, V>>;
+
+template <typename Map, typename K>
+bool eraseKey(Map& map, const K& key)
+{
+  return map.erase(key) != 0;
+}
+
+template <typename K, typename V, typename C>
+bool eraseKey(aisdi::ConcurrentSkipListMap<K, V, C>& map, const K& key) ///API jak w TreeMap: remove zamiast erase
+{
+  return map.remove(key);
+}
+
+enum Phase { Insert, Hit, Miss, Batch, Mixed, Iterate, Copy, Remove, Drain, Churn, PhaseCount };
+
+const char* const phase_names[PhaseCount] = { "insert", "hit", "miss", "batch", "mixed", "iterate", "copy", "remove", "drain", "churn" };
+
+struct Config
+{
+  std::vector<std::string> suites { "maps" };
+  std::vector<std::size_t> sizes { 1000, 100000 };
+  std::vector<unsigned> threads { 1, 2, 4, 8, 16, 32, 64 };
+  std::vector<std::string> maps { "HashMap", "IncrHashMap", "PoolHashMap", "FlatHashMap", "TreeMap", "PoolTreeMap", "BTreeMap", "FrozenTreeMap",
+                                  "PersistentTreeMap", "MappedTreeMap", "MappedHashMap", "LruHashMap", "ClockHashMap",
+                                  "ConcurrentHashMap", "LockedHashMap", "ConcurrentSkipListMap", "LockedTreeMap" };
+  std::vector<std::string> types { "int:int", "int:string", "string:int" };
+  std::vector<Distribution> distributions { Distribution::Sorted, Distribution::Shuffled, Distribution::Zipfian };
+  bool phases[PhaseCount] = { true, true, true, true, true, true, true, true, false, true }; ///drain (remove(begin())) tylko na życzenie
+  unsigned trials = 5;
+  unsigned warmup = 1;
+  std::size_t batch = 1000;
+  double write_ratio = 0.1;
+  std::uint64_t seed = 20170523;
+  Format format = Format::Text;
+  std::string out;
+};
+
+bool contains(const std::vector<std::string>& list, const std::string& item)
+{
+  return std::find(list.begin(), list.end(), item) != list.end();
+}
+
+const std::size_t lookup_batch = 256; ///kluczy na jedno wywołanie contains_batch w fazie batch
+
+template <typename Map, typename K, typename = void>
+struct HasBatch : std::false_type {};
+
+template <typename Map, typename K>
+struct HasBatch<Map, K, aisdi::VoidT<decltype(std::declval<const Map&>().contains_batch(
+                          static_cast<const K*>(nullptr), std::size_t(), static_cast<bool*>(nullptr)))>>
+  : std::true_type {};
+
+template <typename Map, typename K>
+void containsBatch(const Map& map, const K* keys, std::size_t count, bool* results, std::true_type)
+{
+  map.contains_batch(keys, count, results);
+}
+
+template <typename Map, typename K>
+void containsBatch(const Map& map, const K* keys, std::size_t count, bool* results, std::false_type)
+{
+  for (std::size_t i = 0; i < count; ++i) results[i] = map.find(keys[i]) != map.end(); ///mapy bez wersji wsadowej
+}
+
+template <typename Map, typename K, typename V>
+void runCase(const std::string& name, const Workload<K, V>& work, Distribution distribution,
+             const Config& config, Reporter& reporter)
+{
+  const std::size_t n = work.inserts.size();
+  std::vector<Sampler> samplers(PhaseCount, Sampler(config.batch));
+
+  for (unsigned trial = 0; trial < config.warmup + config.trials; ++trial)
+  {
+    const bool record = trial >= config.warmup;
+    std::unique_ptr<Map> map(new Map());
+
+    samplers[Insert].run(n, [&](std::size_t i) { (*map)[work.inserts[i]] = work.values[i]; }, record);
+
+    if (config.phases[Hit])
+      samplers[Hit].run(n, [&](std::size_t i) { doNotOptimize(map->find(work.hits[i]) != map->end()); }, record);
+
+    if (config.phases[Miss])
+      samplers[Miss].run(n, [&](std::size_t i) { doNotOptimize(map->find(work.misses[i]) != map->end()); }, record);
+
+    if (config.phases[Batch]) ///te same klucze co hit, po lookup_batch naraz; pomiar w przeliczeniu na klucz
+    {
+      bool results[lookup_batch];
+      samplers[Batch].run(n, [&](std::size_t i) {
+        if (i % lookup_batch != 0) return;
+        std::size_t count = std::min(lookup_batch, n - i);
+        containsBatch(*map, work.hits.data() + i, count, results, HasBatch<Map, K>());
+        doNotOptimize(results[count - 1]);
+      }, record);
+    }
+
+    if (config.phases[Mixed])
+      samplers[Mixed].run(n, [&](std::size_t i) {
+        if (work.writes[i]) (*map)[work.mixed[i]] = work.values[i];
+        else  doNotOptimize(map->find(work.mixed[i]) != map->end());
+      }, record);
+
+    if (config.phases[Iterate])
+    {
+      auto it = map->begin();
+      samplers[Iterate].run(map->getSize(), [&](std::size_t) { doNotOptimize(it->second); ++it; }, record);
+    }
+
+    if (config.phases[Copy]) ///konstruktor kopiujący, ns na element; niszczenie kopii poza pomiarem
+    {
+      std::unique_ptr<Map> copy;
+      samplers[Copy].runBulk(map->getSize(), [&]() { copy.reset(new Map(*map)); }, record);
+    }
+
+    if (config.phases[Drain])
+      samplers[Drain].run(n, [&](std::size_t) { map->remove(map->begin()); }, record);
+    else if (config.phases[Remove])
+      samplers[Remove].run(n, [&](std::size_t i) { map->remove(work.removals[i]); }, record);
+  }
+
+  for (int phase = 0; phase < PhaseCount; ++phase)
+  {
+    if (!config.phases[phase] || phase == Churn || (phase == Remove && config.phases[Drain])) continue;
+    double mean_total = samplers[phase].medianTotal();
+    reporter.add(Record { "maps", name, Generator<K>::name(), Generator<V>::name(), aisdi::bench::name(distribution),
+                          n, 1, phase_names[phase], samplers[phase].summary(), mean_total > 0 ? 1e9 / mean_total : 0 });
+  }
+}
+
+///FrozenTreeMap nie ma wstawiania ani usuwania: budowana z gotowej TreeMap przez freeze(), którego czas
+///trafia do fazy copy (ns na element); mierzone są tylko odczyty
+template <typename K, typename V>
+void runFrozenCase(const Workload<K, V>& work, Distribution distribution, const Config& config, Reporter& reporter)
+{
+  using Map = aisdi::FrozenTreeMap<K, V>;
+  const std::size_t n = work.inserts.size();
+  std::vector<Sampler> samplers(PhaseCount, Sampler(config.batch));
+  TreeMap<K, V> tree;
+  for (std::size_t i = 0; i < n; ++i) tree[work.inserts[i]] = work.values[i];
+
+  for (unsigned trial = 0; trial < config.warmup + config.trials; ++trial)
+  {
+    const bool record = trial >= config.warmup;
+    std::unique_ptr<Map> map;
+    samplers[Copy].runBulk(n, [&]() { map.reset(new Map(tree.freeze())); }, record);
+
+    if (config.phases[Hit])
+      samplers[Hit].run(n, [&](std::size_t i) { doNotOptimize(map->find(work.hits[i]) != map->end()); }, record);
+
+    if (config.phases[Miss])
+      samplers[Miss].run(n, [&](std::size_t i) { doNotOptimize(map->find(work.misses[i]) != map->end()); }, record);
+
+    if (config.phases[Iterate])
+    {
+      auto it = map->begin();
+      samplers[Iterate].run(map->getSize(), [&](std::size_t) { doNotOptimize(it->second); ++it; }, record);
+    }
+  }
+
+  for (int phase : { Hit, Miss, Iterate, Copy })
+  {
+    if (!config.phases[phase]) continue;
+    double mean_total = samplers[phase].medianTotal();
+    reporter.add(Record { "maps", "FrozenTree", Generator<K>::name(), Generator<V>::name(),
+                          aisdi::bench::name(distribution), n, 1, phase_names[phase], samplers[phase].summary(),
+                          mean_total > 0 ? 1e9 / mean_total : 0 });
+  }
+}
+
+///LruHashMap z pojemnością n/8 - mniej niż różnych kluczy w strumieniu hits także przy zipfian, więc polityki
+///się różnią. insert przechodzi przez wymianę, hit szuka kluczy obecnych (ostatnich wstawionych), miss nieobecnych,
+///mixed to "znajdź albo wczytaj" po strumieniu hits. Liczniki stats() sprawdzane po każdej fazie;
+///trafialność mixed na stderr
+template <aisdi::Eviction Policy, typename K, typename V>
+void runCacheCase(const std::string& name, const Workload<K, V>& work, Distribution distribution,
+                  const Config& config, Reporter& reporter)
+{
+  using Map = aisdi::LruHashMap<K, V, Policy>;
+  const std::size_t n = work.inserts.size();
+  const std::size_t capacity = n / 8 > 0 ? n / 8 : 1;
+  std::vector<Sampler> samplers(PhaseCount, Sampler(config.batch));
+  double hit_rate = 0;
+
+  auto check = [](bool condition) {
+    if (!condition) throw std::runtime_error("LruHashMap counters do not match the workload.");
+  };
+
+  for (unsigned trial = 0; trial < config.warmup + config.trials; ++trial)
+  {
+    const bool record = trial >= config.warmup;
+    std::unique_ptr<Map> map(new Map(capacity));
+
+    samplers[Insert].run(n, [&](std::size_t i) { (*map)[work.inserts[i]] = work.values[i]; }, record);
+    aisdi::CacheStats stats = map->stats();
+    check(stats.size == std::min(n, capacity) && stats.evictions == n - stats.size);
+
+    if (config.phases[Hit])
+    {
+      map->reset_counters();
+      const std::size_t first = n - map->getSize(); ///bez odczytów między wstawieniami obie polityki trzymają ostatnie
+      samplers[Hit].run(n, [&](std::size_t i) {
+        doNotOptimize(map->find(work.inserts[first + i % map->getSize()]) != map->end());
+      }, record);
+      check(map->stats().hits == n);
+    }
+
+    if (config.phases[Miss])
+    {
+      map->reset_counters();
+      samplers[Miss].run(n, [&](std::size_t i) { doNotOptimize(map->find(work.misses[i]) != map->end()); }, record);
+      check(map->stats().misses == n);
+    }
+
+    if (config.phases[Mixed])
+    {
+      map->reset_counters();
+      samplers[Mixed].run(n, [&](std::size_t i) {
+        auto it = map->find(work.hits[i]);
+        if (it == map->end()) map->try_emplace(work.hits[i], work.values[i]);
+        else  doNotOptimize(it->second);
+      }, record);
+      stats = map->stats();
+      check(stats.hits + stats.misses == n && stats.evictions == stats.misses && stats.size == capacity);
+      hit_rate = stats.hit_rate;
+    }
 
-void performTest(std::size_t n)
-{
-  TreeMap<int, std::string> map;
-  HashMap<int, std::string> map2;
-  std::chrono::time_point<std::chrono::system_clock> start, end;
-  unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
-
-  std::vector<int> keys;
-  for (size_t i = 0; i < n; ++i) keys.push_back(i);
-  std::shuffle (keys.begin(), keys.end(), std::default_random_engine(seed));
-
-  start = std::chrono::system_clock::now();
-  for (auto it = keys.begin(); it !=  keys.end(); ++it)
-    map[*it] = "DONE";
-  end = std::chrono::system_clock::now();
-  std::chrono::duration<double> elapsed_seconds = end-start;
-  std::cout << "TreeMap   Add time:       " << elapsed_seconds.count() << "s\n";
-
-  start = std::chrono::system_clock::now();
-  for (auto it = keys.begin(); it !=  keys.end(); ++it)
-    map2[*it] = "DONE";
-  end = std::chrono::system_clock::now();
-  elapsed_seconds = end-start;
-  std::cout << "HashMap   Add time:       " << elapsed_seconds.count() << "s\n";
-
-  seed = std::chrono::system_clock::now().time_since_epoch().count();
-  std::shuffle (keys.begin(), keys.end(), std::default_random_engine(seed));
-
-  start = std::chrono::system_clock::now();
-  for (auto it = keys.begin(); it !=  keys.end(); ++it)
-    map[*it] = "CHANGED";
-  end = std::chrono::system_clock::now();
-  elapsed_seconds = end-start;
-  std::cout << "TreeMap   Change time:    " << elapsed_seconds.count() << "s\n";
-
-  start = std::chrono::system_clock::now();
-  for (auto it = keys.begin(); it !=  keys.end(); ++it)
-    map2[*it] = "CHANGED";
-  end = std::chrono::system_clock::now();
-  elapsed_seconds = end-start;
-  std::cout << "HashMap   Change time:    " << elapsed_seconds.count() << "s\n";
-
-  start = std::chrono::system_clock::now();
-  for (std::size_t i = 0; i < n; ++i)
-    map.remove(begin(map));
-  end = std::chrono::system_clock::now();
-  elapsed_seconds = end-start;
-  std::cout << "TreeMap   Remove time:    " << elapsed_seconds.count() << "s\n";
-
-  start = std::chrono::system_clock::now();
-  for (std::size_t i = 0; i < n; ++i)
-    map2.remove(begin(map2));
-  end = std::chrono::system_clock::now();
-  elapsed_seconds = end-start;
-  std::cout << "HashMap   Remove time:    " << elapsed_seconds.count() << "s\n";
+    if (config.phases[Iterate])
+    {
+      auto it = map->begin();
+      samplers[Iterate].run(map->getSize(), [&](std::size_t) { doNotOptimize(it->second); ++it; }, record);
+    }
+  }
+
+  for (int phase : { Insert, Hit, Miss, Mixed, Iterate })
+  {
+    if (!config.phases[phase]) continue;
+    double mean_total = samplers[phase].medianTotal();
+    reporter.add(Record { "maps", name, Generator<K>::name(), Generator<V>::name(),
+                          aisdi::bench::name(distribution), n, 1, phase_names[phase], samplers[phase].summary(),
+                          mean_total > 0 ? 1e9 / mean_total : 0 });
+  }
+  if (config.phases[Mixed])
+    std::cerr << name << " " << aisdi::bench::name(distribution) << " " << n << ": mixed hit rate " << hit_rate << "\n";
+}
+
+///PersistentTreeMap: zapisy kopiują ścieżkę, więc insert, mixed i remove kosztują więcej niż w TreeMap;
+///faza copy to jedno snapshot() (ns na wywołanie, nie na element) - wersja do czytania bez kopiowania drzewa.
+///Po wstawieniu wynik porównywany z TreeMap::persistent() zbudowaną z tych samych danych
+template <typename K, typename V>
+void runPersistentCase(const Workload<K, V>& work, Distribution distribution, const Config& config, Reporter& reporter)
+{
+  using Map = aisdi::PersistentTreeMap<K, V>;
+  const std::size_t n = work.inserts.size();
+  std::vector<Sampler> samplers(PhaseCount, Sampler(config.batch));
+  TreeMap<K, V> tree;
+  for (std::size_t i = 0; i < n; ++i) tree[work.inserts[i]] = work.values[i];
+  const Map expected = tree.persistent();
+
+  for (unsigned trial = 0; trial < config.warmup + config.trials; ++trial)
+  {
+    const bool record = trial >= config.warmup;
+    std::unique_ptr<Map> map(new Map());
+
+    samplers[Insert].run(n, [&](std::size_t i) { map->insert_or_assign(work.inserts[i], work.values[i]); }, record);
+    if (!(map->snapshot() == expected.snapshot())) throw std::runtime_error("PersistentTreeMap differs from TreeMap.");
+
+    if (config.phases[Hit])
+      samplers[Hit].run(n, [&](std::size_t i) { doNotOptimize(map->find(work.hits[i]) != map->end()); }, record);
+
+    if (config.phases[Miss])
+      samplers[Miss].run(n, [&](std::size_t i) { doNotOptimize(map->find(work.misses[i]) != map->end()); }, record);
+
+    if (config.phases[Mixed])
+      samplers[Mixed].run(n, [&](std::size_t i) {
+        if (work.writes[i]) map->insert_or_assign(work.mixed[i], work.values[i]);
+        else  doNotOptimize(map->find(work.mixed[i]) != map->end());
+      }, record);
+
+    if (config.phases[Iterate])
+    {
+      auto it = map->begin();
+      samplers[Iterate].run(map->getSize(), [&](std::size_t) { doNotOptimize(it->second); ++it; }, record);
+    }
+
+    if (config.phases[Copy])
+      samplers[Copy].run(n, [&](std::size_t) { doNotOptimize(map->snapshot().getSize()); }, record);
+
+    if (config.phases[Remove])
+      samplers[Remove].run(n, [&](std::size_t i) { map->remove(work.removals[i]); }, record);
+  }
+
+  for (int phase : { Insert, Hit, Miss, Mixed, Iterate, Copy, Remove })
+  {
+    if (!config.phases[phase]) continue;
+    double mean_total = samplers[phase].medianTotal();
+    reporter.add(Record { "maps", "Persistent", Generator<K>::name(), Generator<V>::name(),
+                          aisdi::bench::name(distribution), n, 1, phase_names[phase], samplers[phase].summary(),
+                          mean_total > 0 ? 1e9 / mean_total : 0 });
+  }
+}
+
+///snapshot na dysku: save() + open_mapped() to faza copy (ns na element), potem odczyty prosto z pliku.
+///Przy każdej próbie sprawdzane jest, czy plik odtwarza mapę źródłową; tylko typy trywialnie kopiowalne
+template <typename Mapped, typename Source, typename K, typename V>
+void runMappedCase(const std::string& name, const Workload<K, V>& work, Distribution distribution,
+                   const Config& config, Reporter& reporter)
+{
+  const std::size_t n = work.inserts.size();
+  const std::string path = "aisdi-maps-" + std::to_string(::getpid()) + ".snapshot";
+  std::vector<Sampler> samplers(PhaseCount, Sampler(config.batch));
+  Source source;
+  for (std::size_t i = 0; i < n; ++i) source[work.inserts[i]] = work.values[i];
+
+  for (unsigned trial = 0; trial < config.warmup + config.trials; ++trial)
+  {
+    const bool record = trial >= config.warmup;
+    std::unique_ptr<Mapped> map;
+    samplers[Copy].runBulk(n, [&]() {
+      aisdi::save(source, path);
+      map.reset(new Mapped(Mapped::open_mapped(path)));
+    }, record);
+    std::remove(path.c_str()); ///mapowanie zostaje ważne do zamknięcia
+
+    if (map->getSize() != source.getSize()) throw std::runtime_error("Snapshot round trip lost entries.");
+    for (auto it = source.begin(); it != source.end(); ++it)
+    {
+      auto found = map->find(it->first);
+      if (found == map->end() || !(found->second == it->second))
+        throw std::runtime_error("Snapshot round trip changed an entry.");
+    }
+
+    if (config.phases[Hit])
+      samplers[Hit].run(n, [&](std::size_t i) { doNotOptimize(map->find(work.hits[i]) != map->end()); }, record);
+
+    if (config.phases[Miss])
+      samplers[Miss].run(n, [&](std::size_t i) { doNotOptimize(map->find(work.misses[i]) != map->end()); }, record);
+
+    if (config.phases[Iterate])
+    {
+      auto it = map->begin();
+      samplers[Iterate].run(map->getSize(), [&](std::size_t) { doNotOptimize(it->second); ++it; }, record);
+    }
+  }
+
+  for (int phase : { Hit, Miss, Iterate, Copy })
+  {
+    if (!config.phases[phase]) continue;
+    double mean_total = samplers[phase].medianTotal();
+    reporter.add(Record { "maps", name, Generator<K>::name(), Generator<V>::name(),
+                          aisdi::bench::name(distribution), n, 1, phase_names[phase], samplers[phase].summary(),
+                          mean_total > 0 ? 1e9 / mean_total : 0 });
+  }
+}
+
+template <typename K, typename V>
+void runMappedCases(const Workload<K, V>& work, Distribution distribution, const Config& config, Reporter& reporter,
+                    std::true_type)
+{
+  if (contains(config.maps, "MappedTreeMap"))
+    runMappedCase<aisdi::MappedTreeMap<K, V>, TreeMap<K, V>>("MappedTree", work, distribution, config, reporter);
+  if (contains(config.maps, "MappedHashMap"))
+    runMappedCase<aisdi::MappedHashMap<K, V>, HashMap<K, V>>("MappedHash", work, distribution, config, reporter);
+}
+
+template <typename K, typename V>
+void runMappedCases(const Workload<K, V>&, Distribution, const Config&, Reporter&, std::false_type) ///np. std::string
+{
+}
+
+///każda operacja mierzona osobno, do histogramu - widać najgorszy przypadek (np. powiększanie tablicy),
+///który w paczkach po batch operacji ginie w średniej
+template <typename Map, typename K, typename V>
+void runLatencyCase(const std::string& name, const Workload<K, V>& work, Distribution distribution,
+                    const Config& config, Reporter& reporter)
+{
+  const std::size_t n = work.inserts.size();
+  std::vector<Histogram> histograms(PhaseCount);
+
+  for (unsigned trial = 0; trial < config.warmup + config.trials; ++trial)
+  {
+    const bool record = trial >= config.warmup;
+    std::unique_ptr<Map> map(new Map());
+
+    timeEach(histograms[Insert], n, [&](std::size_t i) { (*map)[work.inserts[i]] = work.values[i]; }, record);
+
+    if (config.phases[Hit])
+      timeEach(histograms[Hit], n, [&](std::size_t i) { doNotOptimize(map->find(work.hits[i]) != map->end()); }, record);
+
+    if (config.phases[Mixed])
+      timeEach(histograms[Mixed], n, [&](std::size_t i) {
+        if (work.writes[i]) (*map)[work.mixed[i]] = work.values[i];
+        else  doNotOptimize(map->find(work.mixed[i]) != map->end());
+      }, record);
+
+    if (config.phases[Remove])
+      timeEach(histograms[Remove], n, [&](std::size_t i) { map->remove(work.removals[i]); }, record);
+  }
+
+  for (int phase : { Insert, Hit, Mixed, Remove })
+  {
+    if (!config.phases[phase]) continue;
+    Summary summary = histograms[phase].summary();
+    reporter.add(Record { "latency", name, Generator<K>::name(), Generator<V>::name(), aisdi::bench::name(distribution),
+                          n, 1, phase_names[phase], summary, summary.mean > 0 ? 1e9 / summary.mean : 0 });
+    reporter.histogram(histograms[phase]);
+  }
+}
+
+///każdy wątek wykonuje n operacji, zaczynając od innego miejsca w strumieniu; ops/s liczone z czasu całej próby.
+///hit - same odczyty, mixed - przewaga odczytów (--write-ratio), churn - przewaga zapisów: po ćwierci
+///wstawień i usunięć nieobecnych kluczy, reszta to trafienia
+template <typename Map, typename K, typename V>
+void runThreadCase(const std::string& name, const Workload<K, V>& work, Distribution distribution,
+                   const Config& config, Reporter& reporter)
+{
+  const std::size_t n = work.inserts.size();
+  for (auto threads = config.threads.begin(); threads != config.threads.end(); ++threads)
+    for (int phase : { Hit, Mixed, Churn })
+    {
+      if (!config.phases[phase]) continue;
+      const std::vector<K>& keys = phase == Mixed ? work.mixed : work.hits;
+      Sampler merged(config.batch);
+      std::vector<double> walls;
+
+      for (unsigned trial = 0; trial < config.warmup + config.trials; ++trial)
+      {
+        const bool record = trial >= config.warmup;
+        Map map;
+        for (std::size_t i = 0; i < n; ++i) map.insert_or_assign(work.inserts[i], work.values[i]);
+
+        std::vector<Sampler> samplers(*threads, Sampler(config.batch));
+        std::atomic<unsigned> ready(0);
+        std::atomic<bool> go(false);
+        std::vector<std::thread> workers;
+        for (unsigned t = 0; t < *threads; ++t)
+          workers.emplace_back([&, t]() {
+            const std::size_t offset = t * n / *threads;
+            V value;
+            ready.fetch_add(1);
+            while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
+            samplers[t].run(n, [&](std::size_t i) {
+              std::size_t j = i + offset;
+              if (j >= n) j -= n;
+              if (phase == Churn && (j & 3) == 0) map.insert_or_assign(work.misses[j], work.values[j]);
+              else if (phase == Churn && (j & 3) == 1) doNotOptimize(eraseKey(map, work.misses[j ^ 1]));
+              else if (phase == Mixed && work.writes[j]) map.insert_or_assign(keys[j], work.values[j]);
+              else  doNotOptimize(map.find(keys[j], value));
+            }, record);
+          });
+
+        while (ready.load() != *threads) std::this_thread::yield();
+        auto start = Clock::now();
+        go.store(true, std::memory_order_release);
+        for (auto& worker : workers) worker.join();
+        double wall = seconds(start, Clock::now());
+
+        if (!record) continue;
+        walls.push_back(wall);
+        for (auto& sampler : samplers) merged.merge(sampler);
+      }
+
+      double median_wall = summarize(walls).median;
+      reporter.add(Record { "threads", name, Generator<K>::name(), Generator<V>::name(),
+                            aisdi::bench::name(distribution), n, *threads, phase_names[phase], merged.summary(),
+                            median_wall > 0 ? n * static_cast<double>(*threads) / median_wall : 0 });
+    }
+}
+
+template <typename K, typename V>
+void runTypes(const Config& config, Reporter& reporter)
+{
+  const bool maps_suite = contains(config.suites, "maps");
+  const bool threads_suite = contains(config.suites, "threads");
+  const bool latency_suite = contains(config.suites, "latency");
+  for (auto dist = config.distributions.begin(); dist != config.distributions.end(); ++dist)
+    for (auto size = config.sizes.begin(); size != config.sizes.end(); ++size)
+    {
+      ///ziarno zależy tylko od parametrów przypadku, więc ten sam przypadek dostaje te same dane w każdym uruchomieniu
+      std::uint64_t seed = aisdi::mix(config.seed ^ aisdi::mix(*size * 4 + static_cast<unsigned>(*dist)));
+      Workload<K, V> work(*size, *dist, seed, config.write_ratio);
+
+      if (maps_suite)
+      {
+        if (contains(config.maps, "HashMap")) runCase<HashMap<K, V>>("HashMap", work, *dist, config, reporter);
+        if (contains(config.maps, "IncrHashMap"))
+          runCase<IncrementalHashMap<K, V>>("IncrHashMap", work, *dist, config, reporter);
+        if (contains(config.maps, "PoolHashMap")) runCase<PoolHashMap<K, V>>("PoolHashMap", work, *dist, config, reporter);
+        if (contains(config.maps, "FlatHashMap")) runCase<FlatHashMap<K, V>>("FlatHashMap", work, *dist, config, reporter);
+        if (contains(config.maps, "TreeMap")) runCase<TreeMap<K, V>>("TreeMap", work, *dist, config, reporter);
+        if (contains(config.maps, "PoolTreeMap")) runCase<PoolTreeMap<K, V>>("PoolTreeMap", work, *dist, config, reporter);
+        if (contains(config.maps, "BTreeMap")) runCase<BTreeMap<K, V>>("BTreeMap", work, *dist, config, reporter);
+        if (contains(config.maps, "FrozenTreeMap")) runFrozenCase(work, *dist, config, reporter);
+        if (contains(config.maps, "PersistentTreeMap")) runPersistentCase(work, *dist, config, reporter);
+        if (contains(config.maps, "LruHashMap"))
+          runCacheCase<aisdi::Eviction::Lru>("LruCache", work, *dist, config, reporter);
+        if (contains(config.maps, "ClockHashMap"))
+          runCacheCase<aisdi::Eviction::Clock>("ClockCache", work, *dist, config, reporter);
+        runMappedCases(work, *dist, config, reporter,
+                       std::integral_constant<bool, std::is_trivially_copyable<K>::value
+                                                    && std::is_trivially_copyable<V>::value>());
+      }
+      if (latency_suite)
+      {
+        if (contains(config.maps, "HashMap")) runLatencyCase<HashMap<K, V>>("HashMap", work, *dist, config, reporter);
+        if (contains(config.maps, "IncrHashMap"))
+          runLatencyCase<IncrementalHashMap<K, V>>("IncrHashMap", work, *dist, config, reporter);
+        if (contains(config.maps, "FlatHashMap"))
+          runLatencyCase<FlatHashMap<K, V>>("FlatHashMap", work, *dist, config, reporter);
+        if (contains(config.maps, "TreeMap")) runLatencyCase<TreeMap<K, V>>("TreeMap", work, *dist, config, reporter);
+      }
+      if (threads_suite)
+      {
+        if (contains(config.maps, "ConcurrentHashMap"))
+          runThreadCase<aisdi::ConcurrentHashMap<K, V>>("Concurrent", work, *dist, config, reporter);
+        if (contains(config.maps, "LockedHashMap"))
+          runThreadCase<LockedHashMap<K, V>>("LockedHash", work, *dist, config, reporter);
+        if (contains(config.maps, "ConcurrentSkipListMap"))
+          runThreadCase<aisdi::ConcurrentSkipListMap<K, V>>("SkipList", work, *dist, config, reporter);
+        if (contains(config.maps, "LockedTreeMap"))
+          runThreadCase<LockedTreeMap<K, V>>("LockedTree", work, *dist, config, reporter);
+      }
+    }
+}
+
+std::vector<std::string> split(const std::string& text)
+{
+  std::vector<std::string> parts;
+  std::size_t start = 0;
+  while (start <= text.size())
+  {
+    std::size_t comma = text.find(',', start);
+    if (comma == std::string::npos) comma = text.size();
+    if (comma > start) parts.push_back(text.substr(start, comma - start));
+    start = comma + 1;
+  }
+  return parts;
+}
+
+///tablica zbudowana w czasie kompilacji - static_assert pilnuje, że konstruktor constexpr StaticHashMap działa
+constexpr auto size_suffixes = aisdi::makeStaticHashMap<char, unsigned long long>({
+  { 'K', 1000ULL }, { 'k', 1000ULL }, { 'M', 1000000ULL }, { 'm', 1000000ULL }, { 'G', 1000000000ULL }, { 'g', 1000000000ULL } });
+
+static_assert(size_suffixes.getSize() == 6, "size_suffixes must hold every suffix");
+static_assert(size_suffixes.valueOf('M') == 1000000ULL && size_suffixes.valueOf('g') == 1000000000ULL,
+              "size_suffixes must map suffixes to multipliers");
+static_assert(!size_suffixes.contains('T') && size_suffixes.find('x') == size_suffixes.end(),
+              "size_suffixes must reject unknown suffixes");
+
+std::size_t parseSize(const std::string& text) ///przyjmuje przyrostki K, M, G, np. 100M
+{
+  std::size_t pos = 0;
+  unsigned long long value = std::stoull(text, &pos);
+  std::string suffix = text.substr(pos);
+  if (suffix.size() == 1 && size_suffixes.contains(suffix[0])) value *= size_suffixes.valueOf(suffix[0]);
+  else if (!suffix.empty()) throw std::invalid_argument("Bad size: " + text);
+  return value;
+}
+
+void usage()
+{
+  std::cout <<
+    "usage: maps [size] [options]\n"
+    "  --suites=maps,threads      maps: jednowątkowo; threads: skalowanie map współbieżnych vs mapa za muteksem;\n"
+    "                             latency: czas każdej operacji osobno, z histogramem\n"
+    "  --sizes=1K,100K,10M        liczby elementów (przyrostki K, M, G)\n"
+    "  --threads=1,2,4,...,64     liczby wątków w zestawie threads\n"
+    "  --maps=HashMap,TreeMap,... HashMap IncrHashMap PoolHashMap FlatHashMap TreeMap PoolTreeMap BTreeMap\n"
+    "                             FrozenTreeMap (tylko hit, miss, iterate; copy to czas freeze())\n"
+    "                             PersistentTreeMap (copy to czas jednego snapshot())\n"
+    "                             LruHashMap ClockHashMap (pojemność n/8; bez batch, copy, remove)\n"
+    "                             MappedTreeMap MappedHashMap (typy trywialnie kopiowalne; copy to save + open_mapped)\n"
+    "                             ConcurrentHashMap LockedHashMap ConcurrentSkipListMap LockedTreeMap (zestaw threads)\n"
+    "  --types=int:int,...        int:int int:string string:int uint64:uint64 string:string\n"
+    "  --dist=sorted,...          sorted shuffled zipfian\n"
+    "  --phases=insert,hit,...    insert hit miss batch mixed iterate copy remove drain\n"
+    "                             churn (tylko zestaw threads: przewaga zapisów)\n"
+    "  --trials=5 --warmup=1      liczba mierzonych prób i prób rozgrzewkowych\n"
+    "  --batch=1000               operacji na jedną próbkę czasu (mediana/p99 liczone z próbek)\n"
+    "  --write-ratio=0.1          udział zapisów w fazie mixed\n"
+    "  --seed=N|random            ziarno generatora, domyślnie stałe\n"
+    "  --format=text|csv|json --out=FILE\n";
+}
+
+Config parse(int argc, char** argv)
+{
+  Config config;
+  for (int i = 1; i < argc; ++i)
+  {
+    std::string arg = argv[i];
+    if (arg == "--help" || arg == "-h") { usage(); std::exit(0); }
+    if (arg.compare(0, 2, "--") != 0) { config.sizes = { parseSize(arg) }; continue; } ///dawne wywołanie: maps <n>
+
+    std::string option = arg.substr(2), value;
+    std::size_t eq = option.find('=');
+    if (eq != std::string::npos) { value = option.substr(eq + 1); option.resize(eq); }
+    else if (i + 1 < argc) value = argv[++i];
+    else throw std::invalid_argument("Missing value for --" + option);
+
+    if (option == "suites") config.suites = split(value);
+    else if (option == "threads")
+    {
+      config.threads.clear();
+      for (auto& part : split(value)) config.threads.push_back(std::stoul(part));
+    }
+    else if (option == "sizes")
+    {
+      config.sizes.clear();
+      for (auto& part : split(value)) config.sizes.push_back(parseSize(part));
+    }
+    else if (option == "maps") config.maps = split(value);
+    else if (option == "types") config.types = split(value);
+    else if (option == "dist")
+    {
+      config.distributions.clear();
+      for (auto& part : split(value)) config.distributions.push_back(parseDistribution(part));
+    }
+    else if (option == "phases")
+    {
+      std::vector<std::string> selected = split(value);
+      for (int phase = 0; phase < PhaseCount; ++phase) config.phases[phase] = contains(selected, phase_names[phase]);
+    }
+    else if (option == "trials") config.trials = std::stoul(value);
+    else if (option == "warmup") config.warmup = std::stoul(value);
+    else if (option == "batch") config.batch = std::stoull(value);
+    else if (option == "write-ratio") config.write_ratio = std::stod(value);
+    else if (option == "seed") config.seed = value == "random" ? std::random_device()() : std::stoull(value);
+    else if (option == "format") config.format = parseFormat(value);
+    else if (option == "out") config.out = value;
+    else throw std::invalid_argument("Unknown option --" + option);
+  }
+  return config;
 }
 
 } // namespace
 
 int main(int argc, char** argv)
 {
-  srand(time(NULL));
-  const std::size_t repeatCount = argc > 1 ? std::atoll(argv[1]) : 10000;
-  performTest(repeatCount);
-  //performTest2(repeatCount);
+  Config config;
+  try
+  {
+    config = parse(argc, argv);
+  }
+  catch (const std::exception& e)
+  {
+    std::cerr << e.what() << "\n";
+    usage();
+    return 1;
+  }
+
+  std::ofstream file;
+  if (!config.out.empty()) file.open(config.out);
+  Reporter reporter(config.out.empty() ? std::cout : file, config.format);
+  std::cerr << "seed: " << config.seed << "\n";
+
+  for (auto& types : config.types)
+  {
+    if (types == "int:int") runTypes<int, int>(config, reporter);
+    else if (types == "int:string") runTypes<int, std::string>(config, reporter);
+    else if (types == "string:int") runTypes<std::string, int>(config, reporter);
+    else if (types == "string:string") runTypes<std::string, std::string>(config, reporter);
+    else if (types == "uint64:uint64") runTypes<std::uint64_t, std::uint64_t>(config, reporter);
+    else std::cerr << "Unknown types: " << types << "\n";
+  }
+  reporter.finish();
   return 0;
 }